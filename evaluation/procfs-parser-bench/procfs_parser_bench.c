@@ -0,0 +1,184 @@
+/*
+ * Microbenchmark of parsing /proc/fs/f2fs/<device>/segment_info, comparing
+ * the previous getline()/strsep() based parser with the single pass parser
+ * in libf2fs. A segment_info file in the format of the kernel is generated
+ * for a configurable number of segments, such that no F2FS debug kernel is
+ * required.
+ *
+ * */
+#include "../../zns-tools.fs/lib/libf2fs.c"
+
+#include <time.h>
+
+#define BENCH_FILE "/tmp/zns-tools-segment_info"
+
+/*
+ * The previous parser from libf2fs, reading from a path instead of the
+ * device name. line is initialized, which the previous version did not do.
+ *
+ * */
+static int legacy_procfs_segment_bits(char *path, uint32_t highest_segment,
+                                      struct segment_manager *segman) {
+    FILE *fp;
+    char *line = NULL;
+    size_t len = 0;
+    uint32_t line_ctr = 0;
+    ssize_t read;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return EXIT_FAILURE;
+    }
+
+    while ((read = getline(&line, &len, fp)) != -1) {
+        // Skip first 2 lines that show file format
+        if (line_ctr < 2) {
+            line_ctr++;
+            continue;
+        }
+
+        char *contents;
+        while ((contents = strsep(&line, " \t"))) {
+            if (strchr(contents, '|')) {
+                char *split_string;
+                uint8_t set_first = 0;
+                // sscanf had issues, resort to manual work
+                while ((split_string = strsep(&contents, "|"))) {
+                    if (strcmp(split_string, "|") == 0) {
+                        continue;
+                    } else if (!set_first) {
+                        segman->segments[segman->nr_segments].type =
+                            atoi(split_string);
+                        set_first = 1;
+                    } else {
+                        segman->segments[segman->nr_segments].valid_blocks =
+                            atoi(split_string);
+                    }
+                }
+
+                free(split_string);
+                segman->segments[segman->nr_segments].id = segman->nr_segments;
+                segman->nr_segments++;
+            }
+        }
+
+        free(contents);
+
+        /* only going to max allocated, as specified in the F2FS superblock */
+        if (segman->nr_segments > highest_segment) {
+            goto finish;
+        }
+    }
+
+finish:
+    fclose(fp);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Write a segment_info file in the format of the kernel
+ * (fs/f2fs/sysfs.c:segment_info_seq_show())
+ *
+ * */
+static void generate_segment_info(char *path, uint32_t nr_segments) {
+    FILE *fp;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        ERR_MSG("Failed creating %s\n", path);
+    }
+
+    fprintf(fp, "format: segment_type|valid_blocks\n"
+                "segment_type(0:HD, 1:WD, 2:CD, 3:HN, 4:WN, 5:CN)\n");
+    for (uint32_t i = 0; i < nr_segments; i++) {
+        if ((i % 10) == 0) {
+            fprintf(fp, "%-10d", i);
+        }
+        fprintf(fp, "%d|%-3u", i % NR_CURSEG_TYPE, (i * 7) % 513);
+        if ((i % 10) == 9 || i == (nr_segments - 1)) {
+            fputc('\n', fp);
+        } else {
+            fputc(' ', fp);
+        }
+    }
+
+    fclose(fp);
+}
+
+static double get_time_sec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct segment_manager *alloc_segman(uint32_t nr_segments) {
+    struct segment_manager *segman;
+
+    /* the previous parser writes up to a line of entries past the end */
+    segman = calloc(1, sizeof(struct segment_manager) +
+                           sizeof(struct segment_info) * (nr_segments + 10));
+    if (!segman) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    return segman;
+}
+
+int main(int argc, char *argv[]) {
+    struct segment_manager *legacy, *segman;
+    uint32_t nr_segments = 1000000;
+    uint32_t iterations = 5;
+    double start, legacy_time = 0, parse_time = 0;
+    int fd;
+
+    if (argc > 1) {
+        nr_segments = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        iterations = strtoul(argv[2], NULL, 10);
+    }
+
+    generate_segment_info(BENCH_FILE, nr_segments);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        legacy = alloc_segman(nr_segments);
+        segman = alloc_segman(nr_segments);
+
+        start = get_time_sec();
+        legacy_procfs_segment_bits(BENCH_FILE, nr_segments, legacy);
+        legacy_time += get_time_sec() - start;
+
+        start = get_time_sec();
+        fd = open(BENCH_FILE, O_RDONLY);
+        if (fd < 0) {
+            ERR_MSG("Failed opening %s\n", BENCH_FILE);
+        }
+        f2fs_parse_segment_info(fd, nr_segments, segman);
+        close(fd);
+        parse_time += get_time_sec() - start;
+
+        for (uint32_t j = 0; j < nr_segments; j++) {
+            if (legacy->segments[j].type != segman->segments[j].type ||
+                legacy->segments[j].valid_blocks !=
+                    segman->segments[j].valid_blocks) {
+                ERR_MSG("Parsers differ at segment %u\n", j);
+            }
+        }
+
+        free(legacy);
+        free(segman);
+    }
+
+    MSG("Segments: %u  Iterations: %u\n", nr_segments, iterations);
+    MSG("getline/strsep parser: %10.3f ms\n",
+        legacy_time / iterations * 1000);
+    MSG("single pass parser:    %10.3f ms\n", parse_time / iterations * 1000);
+    MSG("speedup:               %10.2fx\n", legacy_time / parse_time);
+
+    unlink(BENCH_FILE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,24 @@
+#ifndef __CSV_H__
+#define __CSV_H__
+
+#include "zns-tools.h"
+
+#include <stdio.h>
+
+/*
+ * Flat csv export of the zone map
+ *
+ * One row per extent, in zone and PBAS order, with a header row naming the
+ * columns. Addresses and sizes are in 512B sectors, independent of the LBA
+ * format of the device. The segment and heat columns are only set for F2FS
+ * with segment information, and are of the segment the extent starts in,
+ * otherwise they are empty.
+ *
+ * */
+
+#define CSV_WRITE_BUF_SZ 1048576 /* user-space buffer of the csv output */
+#define CSV_HEADER "file,file_id,zone,segment,pbas,len,flags,heat\n"
+
+extern void csv_dump_data(char *file);
+
+#endif
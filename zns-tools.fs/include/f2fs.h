@@ -44,6 +44,9 @@
 #define F2FS_SUPER_OFFSET 1024 /* byte-size offset */
 #define F2FS_BLKSIZE_BITS 12
 #define BLOCK_SZ 4096
+#define F2FS_IO_ALIGN BLOCK_SZ  /* buffer, offset, and size alignment of the
+                                   direct I/O on devices */
+#define F2FS_CP_READ_BLOCKS 16 /* blocks read at once for a checkpoint pack */
 
 struct f2fs_device {
     __u8 path[MAX_PATH_LEN];
@@ -141,6 +144,25 @@ struct f2fs_checkpoint {
 
 static_assert(sizeof(struct f2fs_checkpoint) == 192, "");
 
+#define F2FS_SUPER_MAGIC 0xF2F52010 /* seed of the F2FS CRC32 checksums */
+#define CRCPOLY_LE 0xedb88320
+#define CP_CHKSUM_OFFSET 4092 /* default checksum offset in the cp block */
+#define CP_MIN_CHKSUM_OFFSET sizeof(struct f2fs_checkpoint)
+
+/*
+ * Allocation type of a current segment (f2fs_checkpoint::alloc_type)
+ */
+#define LFS 0 /* appending to a free segment */
+#define SSR 1 /* reusing invalid blocks of a dirty segment */
+
+/*
+ * Checkpoint flags (f2fs_checkpoint::ckpt_flags)
+ */
+#define CP_LARGE_NAT_BITMAP_FLAG 0x00000400
+#define CP_FASTBOOT_FLAG 0x00000020
+#define CP_COMPACT_SUM_FLAG 0x00000004
+#define CP_UMOUNT_FLAG 0x00000001
+
 enum type {
     CURSEG_HOT_DATA = 0, /* directory entry blocks */
     CURSEG_WARM_DATA,    /* data blocks */
@@ -175,6 +197,149 @@ struct f2fs_nat_block {
 
 static_assert(sizeof(struct f2fs_nat_block) == 4095, "");
 
+/*
+ * For SIT entries
+ */
+#define SIT_VBLOCK_MAP_SIZE 64
+
+struct f2fs_sit_entry {
+    __le16 vblocks;                      /* valid blocks (low 10 bits) and
+                                            segment type (high 6 bits) */
+    __u8 valid_map[SIT_VBLOCK_MAP_SIZE]; /* bitmap for valid blocks */
+    __le64 mtime;                        /* segment age for cleaning */
+} __attribute__((packed));
+
+static_assert(sizeof(struct f2fs_sit_entry) == 74, "");
+
+#define SIT_ENTRY_PER_BLOCK (PAGE_CACHE_SIZE / sizeof(struct f2fs_sit_entry))
+
+#define SIT_VBLOCKS_SHIFT 10
+#define SIT_VBLOCKS_MASK ((1 << SIT_VBLOCKS_SHIFT) - 1)
+#define GET_SIT_VBLOCKS(raw_sit) ((raw_sit)->vblocks & SIT_VBLOCKS_MASK)
+#define GET_SIT_TYPE(raw_sit) ((raw_sit)->vblocks >> SIT_VBLOCKS_SHIFT)
+
+struct f2fs_sit_block {
+    struct f2fs_sit_entry entries[SIT_ENTRY_PER_BLOCK];
+} __attribute__((packed));
+
+static_assert(sizeof(struct f2fs_sit_block) == 4070, "");
+
+/*
+ * For segment summary (SSA) and the NAT/SIT journals in the checkpoint
+ */
+#define ENTRIES_IN_SUM 512
+#define SUMMARY_SIZE 7    /* sizeof(struct f2fs_summary) */
+#define SUM_FOOTER_SIZE 5 /* sizeof(struct summary_footer) */
+#define SUM_ENTRY_SIZE (SUMMARY_SIZE * ENTRIES_IN_SUM)
+#define SUM_JOURNAL_SIZE (BLOCK_SZ - SUM_FOOTER_SIZE - SUM_ENTRY_SIZE)
+
+/* summary_footer::entry_type */
+#define SUM_TYPE_NODE (1)
+#define SUM_TYPE_DATA (0)
+
+#define NR_CURSEG_DATA_TYPE 3
+#define NR_CURSEG_NODE_TYPE 3
+#define NR_CURSEG_TYPE (NR_CURSEG_DATA_TYPE + NR_CURSEG_NODE_TYPE)
+
+struct f2fs_summary {
+    __le32 nid; /* parent node id */
+    union {
+        __u8 reserved[3];
+        struct {
+            __u8 version;       /* node version number */
+            __le16 ofs_in_node; /* block index in parent node */
+        } __attribute__((packed));
+    };
+} __attribute__((packed));
+
+static_assert(sizeof(struct f2fs_summary) == SUMMARY_SIZE, "");
+
+struct summary_footer {
+    unsigned char entry_type; /* SUM_TYPE_XXX */
+    __le32 check_sum;         /* summary checksum */
+} __attribute__((packed));
+
+static_assert(sizeof(struct summary_footer) == SUM_FOOTER_SIZE, "");
+
+struct nat_journal_entry {
+    __le32 nid;
+    struct f2fs_nat_entry ne;
+} __attribute__((packed));
+
+#define NAT_JOURNAL_ENTRIES                                                    \
+    ((SUM_JOURNAL_SIZE - 2) / sizeof(struct nat_journal_entry))
+#define NAT_JOURNAL_RESERVED                                                   \
+    ((SUM_JOURNAL_SIZE - 2) % sizeof(struct nat_journal_entry))
+
+struct nat_journal {
+    struct nat_journal_entry entries[NAT_JOURNAL_ENTRIES];
+    __u8 reserved[NAT_JOURNAL_RESERVED];
+} __attribute__((packed));
+
+struct sit_journal_entry {
+    __le32 segno;
+    struct f2fs_sit_entry se;
+} __attribute__((packed));
+
+#define SIT_JOURNAL_ENTRIES                                                    \
+    ((SUM_JOURNAL_SIZE - 2) / sizeof(struct sit_journal_entry))
+#define SIT_JOURNAL_RESERVED                                                   \
+    ((SUM_JOURNAL_SIZE - 2) % sizeof(struct sit_journal_entry))
+
+struct sit_journal {
+    struct sit_journal_entry entries[SIT_JOURNAL_ENTRIES];
+    __u8 reserved[SIT_JOURNAL_RESERVED];
+} __attribute__((packed));
+
+struct f2fs_journal {
+    union {
+        __le16 n_nats; /* number of entries in nat_j */
+        __le16 n_sits; /* number of entries in sit_j */
+    };
+    union {
+        struct nat_journal nat_j;
+        struct sit_journal sit_j;
+        __u8 info[SUM_JOURNAL_SIZE - 2];
+    };
+} __attribute__((packed));
+
+static_assert(sizeof(struct f2fs_journal) == SUM_JOURNAL_SIZE, "");
+
+struct f2fs_summary_block {
+    struct f2fs_summary entries[ENTRIES_IN_SUM];
+    struct f2fs_journal journal;
+    struct summary_footer footer;
+} __attribute__((packed));
+
+static_assert(sizeof(struct f2fs_summary_block) == BLOCK_SZ, "");
+
+/* a device that libf2fs reads metadata from, opened once per run */
+struct f2fs_dev {
+    char *dev_path; /* path the device was opened with */
+    int fd;         /* open file descriptor of the device */
+    uint8_t direct; /* fd is opened with O_DIRECT */
+};
+
+#define F2FS_READ_QUEUE_DEPTH 32 /* default concurrent reads of a batch */
+
+/* a read of a batch of reads, issued with f2fs_read_dev_batch() */
+struct f2fs_read_req {
+    char *dev_path;  /* device to read from */
+    uint64_t offset; /* byte offset on the device */
+    size_t size;     /* size of the read in bytes */
+    void *dest;      /* destination, allocated with f2fs_alloc_io_buf() */
+    uint8_t done;    /* set to 1 if the read completed */
+};
+
+/*
+ * In-memory NAT, with the entries of all nids from the active NAT copy and
+ * the NAT journal
+ */
+struct f2fs_nat_index {
+    uint32_t nr_nids;                /* number of entries in entries[] */
+    struct f2fs_nat_entry entries[]; /* NAT entries indexed by nid */
+};
+
 /*
  * For NODE structure
  */
@@ -312,39 +477,83 @@ struct f2fs_node {
 
 static_assert(sizeof(struct f2fs_node) == 4096, "");
 
+#define SEGMENT_FRAG_UNKNOWN UINT32_MAX
+#define CURSEG_NOT_OPEN UINT32_MAX
+
+#define PROCFS_READ_BYTES 65536 /* read size for parsing procfs files */
+
 struct segment_info {
     unsigned int id;
     enum type type;
     uint32_t valid_blocks;
-    /* uint8_t bitmap[]; */ /* TODO: we can get this info from segment_bits */
+    uint32_t frag;       /* fragmentation of the valid blocks in percent,
+                            SEGMENT_FRAG_UNKNOWN without valid block bitmaps */
+    uint32_t log_blkoff; /* next block to allocate if the segment is an open
+                            log, CURSEG_NOT_OPEN otherwise */
+};
+
+/* a current segment (open log) of F2FS, as of the active checkpoint */
+struct f2fs_curseg {
+    uint32_t segno;     /* main area segment number of the log */
+    uint16_t blkoff;    /* next block to allocate in the segment */
+    uint8_t alloc_type; /* LFS or SSR allocation of the segment */
 };
 
 struct segment_manager {
-    uint32_t nr_segments; /* number of segments in segments[] */
+    uint32_t nr_segments;      /* number of segments in segments[] */
+    uint32_t zns_segno_offset; /* main area segment number of the first
+                                  segment on the ZNS device */
+    unsigned char *valid_maps; /* SIT_VBLOCK_MAP_SIZE bytes of valid block
+                                  bitmap per segment, NULL if not loaded */
+    struct f2fs_curseg cursegs[NR_CURSEG_TYPE]; /* open logs by enum type */
     struct segment_info segments[];
 };
 
+struct f2fs_gc_estimate {
+    uint32_t nr_segments;  /* written segments in the range */
+    uint64_t valid_blocks; /* valid blocks GC has to migrate */
+    uint64_t dead_blocks;  /* invalid blocks GC reclaims */
+};
+
 extern struct f2fs_super_block f2fs_sb;
 extern struct f2fs_checkpoint f2fs_cp;
 
+extern void *f2fs_alloc_io_buf(size_t);
+extern uint8_t f2fs_read_dev(char *, void *, uint64_t, size_t);
+extern uint32_t f2fs_read_dev_batch(struct f2fs_read_req *, uint32_t,
+                                    uint32_t);
+extern void f2fs_close_devs();
 extern void f2fs_read_super_block(char *);
 extern void f2fs_show_super_block();
 extern void f2fs_read_checkpoint(char *);
 extern void f2fs_show_checkpoint();
-struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *, uint32_t);
+extern struct f2fs_nat_index *f2fs_load_nat_index(char *);
+extern struct f2fs_nat_entry *f2fs_get_nat_entry(struct f2fs_nat_index *,
+                                                 uint32_t);
 struct f2fs_node *f2fs_get_node_block(char *, uint32_t);
+extern struct f2fs_summary_block *f2fs_read_ssa(char *, uint32_t, uint32_t);
 extern void f2fs_show_inode_info(struct f2fs_inode *);
 extern fs_manager_cleanup f2fs_fs_manager_cleanup();
 extern fs_info_init f2fs_fs_info_init();
 extern fs_info_show f2fs_fs_info_show();
 extern fs_info_cleanup f2fs_fs_info_cleanup();
 extern uint32_t get_fs_info_bytes();
-extern void *f2fs_fs_manager_init();
+extern void *f2fs_fs_manager_init(char *, uint64_t, uint8_t);
+extern uint8_t f2fs_estimate_gc(void *, uint32_t, uint64_t,
+                                struct f2fs_gc_estimate *);
+extern uint8_t f2fs_get_curseg(void *, enum type, uint32_t *, uint32_t *,
+                               uint8_t *);
+extern const char *f2fs_type_name(enum type);
 
 static inline int IS_INODE(struct f2fs_node *node) {
     return ((node)->footer.nid == (node)->footer.ino);
 }
 
+/* F2FS bitmaps (e.g., NAT and SIT version bitmaps) are MSB first */
+static inline int f2fs_test_bit(unsigned int nr, const unsigned char *addr) {
+    return addr[nr >> 3] & (1 << (7 - (nr & 0x07)));
+}
+
 #define ERR_MSG(fmt, ...)                                                      \
     do {                                                                       \
         printf("\033[0;31mError\033[0m: [%s:%d] " fmt, __func__, __LINE__,     \
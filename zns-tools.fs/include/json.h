@@ -3,5 +3,33 @@
 
 #include "zns-tools.h"
 
+#include <stdio.h>
+
+#define JSON_MAX_DEPTH 16         /* max nesting of objects and arrays */
+#define JSON_WRITE_BUF_SZ 1048576 /* user-space buffer of the json output */
+
+struct json_writer {
+    FILE *fp;                          /* output file of the writer */
+    char *buf;                         /* stdio buffer of fp */
+    uint32_t depth;                    /* current nesting depth */
+    uint8_t has_items[JSON_MAX_DEPTH]; /* if the level has written members */
+};
+
+extern void json_writer_open(struct json_writer *w, char *file);
+extern void json_writer_close(struct json_writer *w, char *file);
+extern void json_begin_object(struct json_writer *w, const char *key);
+extern void json_begin_object_nr(struct json_writer *w, uint64_t key);
+extern void json_end_object(struct json_writer *w);
+extern void json_begin_array(struct json_writer *w, const char *key);
+extern void json_end_array(struct json_writer *w);
+extern void json_add_string(struct json_writer *w, const char *key,
+                            const char *value);
+extern void json_add_hex(struct json_writer *w, const char *key,
+                         uint64_t value);
+extern void json_add_uint(struct json_writer *w, const char *key,
+                          uint64_t value);
+extern void json_add_bool(struct json_writer *w, const char *key,
+                          uint8_t value);
+
 extern int json_dump_data();
 #endif
@@ -0,0 +1,148 @@
+#ifndef __REPORT_H__
+#define __REPORT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Buffered report output
+ *
+ * Reports write to stdout with a large user-space buffer, such that a report
+ * of millions of extents is written with few write() calls. Lines that are
+ * printed for every extent or segment are built in a struct rep_line with the
+ * helpers below, which format numbers by hand instead of parsing a printf()
+ * format string for every line. MSG() and REP() write to the same stdout
+ * buffer, hence both can be mixed in a report.
+ *
+ * */
+
+#define REP_BUF_SZ 1048576 /* user-space buffer of stdout */
+#define REP_LINE_SZ 512    /* line buffer, longer lines are written in parts */
+#define REP_NUM_LEN 24     /* max characters of a formatted number */
+
+struct rep_line {
+    uint32_t len;          /* bytes of the line in buf */
+    char buf[REP_LINE_SZ]; /* line that is being built */
+};
+
+/*
+ * Enable the large stdout buffer, has to be called before anything is written
+ * to stdout. A terminal stays line buffered, such that the report shows up
+ * while it is being built.
+ *
+ * */
+static inline void rep_init() {
+    static char buf[REP_BUF_SZ];
+
+    if (isatty(STDOUT_FILENO)) {
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    } else {
+        setvbuf(stdout, buf, _IOFBF, REP_BUF_SZ);
+    }
+}
+
+static inline void rep_write(struct rep_line *line) {
+    fwrite(line->buf, 1, line->len, stdout);
+    line->len = 0;
+}
+
+static inline void rep_add_mem(struct rep_line *line, const char *mem,
+                               uint32_t len) {
+    if (line->len + len > REP_LINE_SZ) {
+        rep_write(line);
+        if (len > REP_LINE_SZ) {
+            fwrite(mem, 1, len, stdout);
+            return;
+        }
+    }
+
+    memcpy(&line->buf[line->len], mem, len);
+    line->len += len;
+}
+
+static inline void rep_add_pad(struct rep_line *line, uint32_t len,
+                               uint32_t width) {
+    static const char spaces[] = "                                "
+                                 "                                ";
+
+    while (len < width) {
+        uint32_t pad = width - len < sizeof(spaces) - 1 ? width - len
+                                                        : sizeof(spaces) - 1;
+
+        rep_add_mem(line, spaces, pad);
+        len += pad;
+    }
+}
+
+static inline void rep_add_str(struct rep_line *line, const char *str) {
+    rep_add_mem(line, str, strlen(str));
+}
+
+/* same as printf("%*s", width, str) */
+static inline void rep_add_str_right(struct rep_line *line, const char *str,
+                                     uint32_t width) {
+    uint32_t len = strlen(str);
+
+    rep_add_pad(line, len, width);
+    rep_add_mem(line, str, len);
+}
+
+/* same as printf("%#-*lx", width, value) */
+static inline void rep_add_hex(struct rep_line *line, uint64_t value,
+                               uint32_t width) {
+    static const char digits[] = "0123456789abcdef";
+    char num[REP_NUM_LEN];
+    uint32_t i = REP_NUM_LEN;
+
+    do {
+        num[--i] = digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    /* like printf(), zero has no prefix */
+    if (i != REP_NUM_LEN - 1 || num[i] != '0') {
+        num[--i] = 'x';
+        num[--i] = '0';
+    }
+
+    rep_add_mem(line, &num[i], REP_NUM_LEN - i);
+    rep_add_pad(line, REP_NUM_LEN - i, width);
+}
+
+/* same as printf("%-*lu", width, value) */
+static inline void rep_add_uint(struct rep_line *line, uint64_t value,
+                                uint32_t width) {
+    char num[REP_NUM_LEN];
+    uint32_t i = REP_NUM_LEN;
+
+    do {
+        num[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    rep_add_mem(line, &num[i], REP_NUM_LEN - i);
+    rep_add_pad(line, REP_NUM_LEN - i, width);
+}
+
+/* same as printf("  PBAS: %#-10lx  PBAE: %#-10lx  SIZE: %#-10lx", ...) */
+static inline void rep_add_range(struct rep_line *line, uint64_t pbas,
+                                 uint64_t pbae, uint64_t size) {
+    rep_add_str(line, "  PBAS: ");
+    rep_add_hex(line, pbas, 10);
+    rep_add_str(line, "  PBAE: ");
+    rep_add_hex(line, pbae, 10);
+    rep_add_str(line, "  SIZE: ");
+    rep_add_hex(line, size, 10);
+}
+
+/* write a fixed string, without the formatting of MSG() */
+#define REP_PUTS(n, str)                                                       \
+    do {                                                                       \
+        if (n == 0) {                                                          \
+            fputs(str, stdout);                                                \
+        }                                                                      \
+    } while (0)
+
+#endif
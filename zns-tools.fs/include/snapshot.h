@@ -0,0 +1,132 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "zns-tools.h"
+
+#include <endian.h>
+
+/*
+ * Binary zone map snapshot
+ *
+ * A snapshot is a little-endian file of a fixed size header followed by
+ * columns. Each column holds a single field of all rows of its table, and
+ * starts at an 8 byte aligned file offset that is stored in the header, such
+ * that a mmap()ed snapshot is queried with the accessors below without any
+ * parsing.
+ *
+ * Tables are the zones of the ZNS device (row is the zone number), the F2FS
+ * segments occupied by extents in ascending id, the extents sorted by zone and
+ * PBAS, and the files (row is the fileID of the extents). The path of a file is
+ * an offset into the path table, which holds the null terminated paths.
+ *
+ * */
+
+#define SNAP_MAGIC "ZNSSNAP"
+#define SNAP_MAGIC_LEN 8
+#define SNAP_VERSION 1
+#define SNAP_ALIGN 8                 /* alignment of columns in the file */
+#define SNAP_DEV_NAME_LEN 16         /* bytes of device names in the header */
+#define SNAP_DEV_PATH_LEN 64         /* bytes of device paths in the header */
+#define SNAP_PROGRAM_LEN 64          /* bytes of the program in the header */
+#define SNAP_WRITE_BUF_SZ 1048576    /* user-space buffer of the writer */
+#define SNAP_SEGMENT_NOT_FOUND UINT64_MAX
+
+enum snap_table {
+    SNAP_ZONES = 0,
+    SNAP_SEGMENTS,
+    SNAP_EXTENTS,
+    SNAP_FILES,
+    SNAP_PATHS, /* rows are the bytes of the path table */
+    SNAP_NR_TABLES,
+};
+
+enum snap_col {
+    SNAP_ZONE_START = 0, /* uint64_t PBAS of the zone */
+    SNAP_ZONE_CAP,       /* uint64_t capacity of the zone */
+    SNAP_ZONE_WP,        /* uint64_t write pointer of the zone */
+    SNAP_ZONE_SIZE,      /* uint64_t size of the zone */
+    SNAP_ZONE_STATE,     /* uint32_t state of the zone */
+    SNAP_SEG_ID,         /* uint64_t segment id, relative to the ZNS device */
+    SNAP_SEG_TYPE,       /* uint32_t enum type of the segment */
+    SNAP_SEG_VALID,      /* uint32_t valid blocks of the segment */
+    SNAP_EXT_PBAS,       /* uint64_t PBAS of the extent */
+    SNAP_EXT_LEN,        /* uint64_t length of the extent */
+    SNAP_EXT_LBAS,       /* uint64_t logical start of the extent */
+    SNAP_EXT_FILE,       /* uint32_t fileID of the extent */
+    SNAP_EXT_NR,         /* uint32_t extent number in the file */
+    SNAP_EXT_FLAGS,      /* uint32_t FIEMAP flags of the extent */
+    SNAP_EXT_ZONE,       /* uint32_t zone of the extent */
+    SNAP_FILE_PATH,      /* uint64_t offset of the path in the path table */
+    SNAP_FILE_EXTS,      /* uint32_t number of extents of the file */
+    SNAP_PATH_DATA,      /* char null terminated paths */
+    SNAP_NR_COLS,
+};
+
+struct snap_dev {
+    char dev_name[SNAP_DEV_NAME_LEN];  /* device name (e.g., nvme0n2) */
+    char dev_path[SNAP_DEV_PATH_LEN];  /* device path (e.g., /dev/nvme0n2) */
+    char link_name[SNAP_DEV_PATH_LEN]; /* linkname of the device */
+    uint32_t is_zoned;                 /* flag if device is a zoned device */
+    uint32_t zone_mask;                /* zone mask of the device */
+    uint64_t nr_zones;                 /* number of zones of the device */
+    uint64_t zone_size;                /* zone size of the device */
+};
+
+/* on-disk header of a snapshot, all fields are little-endian */
+struct snap_header {
+    char magic[SNAP_MAGIC_LEN];     /* SNAP_MAGIC */
+    uint32_t version;               /* SNAP_VERSION of the writer */
+    uint32_t header_bytes;          /* size of the header */
+    uint64_t time;                  /* time the snapshot was taken */
+    uint64_t fs_magic;              /* file system magic value */
+    char program[SNAP_PROGRAM_LEN]; /* program that wrote the snapshot */
+    struct snap_dev bdev;           /* conventional device of F2FS */
+    struct snap_dev znsdev;         /* ZNS device */
+    uint32_t multi_dev;             /* flag if bdev is used */
+    uint32_t sector_size;           /* sector size of the ZNS device */
+    uint32_t sector_shift;          /* bit shift for sector conversion */
+    uint32_t segment_shift;         /* bit shift for segment conversion */
+    uint64_t f2fs_segment_sectors;  /* sectors in a segment */
+    uint64_t f2fs_segment_mask;     /* mask of sectors to segment start */
+    uint64_t rows[SNAP_NR_TABLES];  /* number of rows of each table */
+    uint64_t cols[SNAP_NR_COLS];    /* file offset of each column */
+};
+
+struct snapshot {
+    int fd;                  /* open file descriptor of the snapshot */
+    size_t size;             /* size of the snapshot */
+    const char *map;         /* mmap()ed snapshot */
+    struct snap_header *hdr; /* header at the start of the mapping */
+};
+
+extern void snap_write(char *file);
+extern void snap_open(struct snapshot *snap, char *file);
+extern void snap_close(struct snapshot *snap);
+extern uint64_t snap_find_segment(struct snapshot *snap, uint64_t id);
+
+static inline uint64_t snap_rows(struct snapshot *snap, enum snap_table t) {
+    return le64toh(snap->hdr->rows[t]);
+}
+
+static inline uint64_t snap_u64(struct snapshot *snap, enum snap_col col,
+                                uint64_t row) {
+    const uint64_t *c =
+        (const uint64_t *)(snap->map + le64toh(snap->hdr->cols[col]));
+
+    return le64toh(c[row]);
+}
+
+static inline uint32_t snap_u32(struct snapshot *snap, enum snap_col col,
+                                uint64_t row) {
+    const uint32_t *c =
+        (const uint32_t *)(snap->map + le64toh(snap->hdr->cols[col]));
+
+    return le32toh(c[row]);
+}
+
+static inline const char *snap_path(struct snapshot *snap, uint64_t file) {
+    return snap->map + le64toh(snap->hdr->cols[SNAP_PATH_DATA]) +
+           snap_u64(snap, SNAP_FILE_PATH, file);
+}
+
+#endif
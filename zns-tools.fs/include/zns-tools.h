@@ -2,6 +2,7 @@
 #define __ZNS_TOOLS_H__
 
 #include "f2fs.h"
+#include "report.h"
 
 #include <fcntl.h>
 #include <libgen.h>
@@ -26,14 +27,16 @@
 
 #include <linux/blkzoned.h>
 
-#include <json-c/json.h>
-
 #define F2FS_SEGMENT_BYTES 2097152
 
-#define MAX_FILE_LENGTH 50
 #define MAX_DEV_NAME 15
 
 #define ZNS_TOOLS_MAX_DEVS 2
+#define FIEMAP_EXTENT_BATCH 512 /* extents retrieved per FIEMAP ioctl() */
+#define FILE_COUNTER_MIN_ENTRIES 64 /* initial entries in file_counter_map */
+#define ZONE_EXTENTS_MIN_ENTRIES 16 /* initial extent entries of a zone */
+#define EXTENT_SLAB_ENTRIES 4096    /* extents allocated per extent_slab */
+#define PATH_CHUNK_BYTES 65536      /* bytes of a path_chunk for file paths */
 #define F2FS_SECS_PER_BLOCK 9
 
 #define BTRFS_MAGIC 0x9123683E
@@ -54,20 +57,31 @@ struct extent {
     uint32_t zone;   /* zone index of the extent */
     uint32_t flags;  /* Flags given by ioctl() FIEMAP call */
     uint32_t ext_nr; /* Extent number as returned in the order by ioctl */
-    uint32_t
-        fileID; /* Unique ID of the file to simplify statistics collection */
+    uint32_t fileID; /* Unique ID of the file, which is its index in the
+                        file_counter_map */
     uint64_t logical_blk; /* LBA starting address of the extent */
     uint64_t phy_blk;     /* PBA starting address of the extent */
-    uint64_t zone_lbas;   /* LBAS of the zone the extent is in */
-    uint64_t zone_cap;    /* Zone capacity */
     uint64_t len;         /* Length of the extent in 512B sectors */
-    uint64_t zone_size;   /* Size of the zone the extent is in */
-    uint64_t zone_wp;     /* Write Pointer of this current zone */
-    uint64_t zone_lbae;   /* LBA that can be written up to (LBAS + ZONE CAP) */
     void *fs_info; /* file system specific information - segment information for
-                    * F2FS NOTE: must be the last field of the struct, as the
-                    * size can vary */
-    char file[MAX_FILE_LENGTH]; /* file path to which the extent belongs */
+                    * F2FS, stored directly after the extent in its slab slot */
+};
+
+/*
+ * Extents retrieved with FIEMAP. The number of each extent in the logical
+ * order of its file is kept in fe_reserved[FIEMAP_EXT_NR], as extents outside
+ * of the zone range are not stored in the buffer.
+ *
+ * */
+#define FIEMAP_EXT_NR 0
+
+struct fiemap_buffer {
+    struct fiemap_extent *extents; /* retrieved FIEMAP extents */
+    uint32_t nr_extents;           /* number of extents in *extents */
+    uint32_t cap;                  /* number of allocated entries in *extents */
+    uint32_t file_ext_ctr;         /* number of extents of the last file,
+                                      including the dropped extents */
+    uint64_t range_extent_ctr;     /* extents dropped for being outside of
+                                      the zone range */
 };
 
 struct extent_map {
@@ -78,25 +92,31 @@ struct extent_map {
     struct extent extents[]; /* Array of struct extent for each extent */
 };
 
-struct node {
-    struct extent *extent;
-    struct node *next;
-};
-
 struct zone {
     uint32_t zone_number;      /* number of the zone */
     uint64_t start;            /* PBAS of the zone */
     uint64_t end;              /* PBAE of the zone */
     uint64_t capacity;         /* capacity of the zone */
     uint64_t wp;               /* write pointer of the zone */
-    uint8_t state;             /* capacity of the zone */
+    uint64_t size;             /* size of the zone */
+    uint8_t state;             /* state of the zone */
     uint32_t mask;             /* mask of the zone */
     uint32_t extent_ctr;       /* number of extents in the zone */
-    struct node *extents_head; /* pointer to head of sorted singly linked list
-                                  of the extents in the zone */
+    uint32_t extent_cap;       /* number of entries allocated in extents */
+    uint8_t sorted;            /* extents are sorted by phy_blk */
+    struct extent **extents;   /* extents in the zone, sorted by phy_blk after
+                                  sort_zone_map() */
+};
+
+struct extent_slab {
+    struct extent_slab *next; /* previously filled slab */
+    uint32_t used;            /* number of slots handed out */
+    uint32_t slot_size;       /* bytes of a slot, extent and its fs_info */
+    char slots[];             /* EXTENT_SLAB_ENTRIES slots */
 };
 
 struct zone_map {
+    struct extent_slab *slabs; /* slabs holding all extents, newest first */
     uint32_t nr_zones;   /* number of zones in struct zone *zones */
     uint64_t extent_ctr; /* counter for total number of extents */
     uint64_t
@@ -107,8 +127,8 @@ struct zone_map {
 
 /* count for each file the number of extents */
 struct file_counter {
-    char file[MAX_FILE_LENGTH]; /* file name, fix maximum file length to avoid
-                                   messy reallocs */
+    char *file;                 /* file name (full path), stored in the
+                                   path_chunks of the file_counter_map */
     uint32_t ext_ctr;           /* extent counter for the file */
     uint32_t segment_ctr;       /* number of segments the file contained in */
     uint32_t zone_ctr;          /* number of zones the file is contained in */
@@ -125,8 +145,17 @@ struct file_counter {
      */
 };
 
+struct path_chunk {
+    struct path_chunk *next; /* previously filled chunk */
+    uint32_t used;           /* number of bytes used in data */
+    uint32_t size;           /* number of bytes allocated in data */
+    char data[];             /* null terminated file paths */
+};
+
 struct file_counter_map {
+    struct path_chunk *paths; /* chunks holding the file paths, newest first */
     uint32_t file_ctr; /* indicate the number of file entries in *files */
+    uint32_t file_cap; /* number of allocated entries in *files */
     struct file_counter files[]; /* track the file counters */
 };
 
@@ -146,9 +175,11 @@ struct control {
     uint8_t show_flags; /* cmd_line flag to show extent flags */
     uint8_t json_dump;  /* dump collected data as json */
     char *json_file;    /* json file name to output data to */
-    json_object *json_root; /* root json object for data output */
-    uint8_t info;           /* cmd_line flag to show info */
-    uint64_t fs_magic;      /* store the file system magic value */
+    uint64_t json_time; /* time of the json data, current time if 0 */
+    char *snap_file;    /* binary snapshot file to write the zone map to */
+    char *csv_file;     /* csv file to write the extents of the zone map to */
+    uint8_t info;       /* cmd_line flag to show info */
+    uint64_t fs_magic;  /* store the file system magic value */
 
     unsigned int sector_size;  /* Size of sectors on the ZNS device */
     unsigned int sector_shift; /* bit shift for sector conversion */
@@ -175,6 +206,10 @@ struct control {
     unsigned int segment_shift;
     uint32_t start_zone;    /* Zone to start segmap report from */
     uint32_t end_zone;      /* Zone to end segmap report at */
+    uint8_t zone_range_only; /* only collect extents that start in the zones
+                                from start_zone to end_zone */
+    uint64_t range_extent_ctr; /* track the number of extents outside of the
+                                  collected zone range */
     uint32_t nr_files;      /* Total number of files in segmap */
     uint32_t exclude_flags; /* Flags of extents that are excluded in maintaining
                                mapping */
@@ -183,7 +218,8 @@ struct control {
         cur_segment; /* tracking which segment we are currently in for segmap */
     uint8_t show_superblock; /* zns.inode flag to print superblock */
     uint8_t show_checkpoint; /* zns.inode flag to print checkpoint */
-    uint8_t procfs; /* zns.segmap use procfs entry segment_info from F2FS */
+    uint8_t procfs; /* zns.segmap use procfs entry segment_info from F2FS
+                       instead of the SIT */
     uint8_t
         show_class_stats;    /* zns.segmap show stats of heat classifications */
     uint8_t show_only_stats; /* zns.segmap only show class stats not segment
@@ -191,6 +227,10 @@ struct control {
     uint8_t const_fsync;     /* zns.fpbench fsync after each written bock */
     uint8_t o_direct;        /* zns.fpbench use direct I/O */
     uint64_t inlined_extent_ctr;   /* track the number of inlined extents */
+    uint8_t no_sync;               /* don't sync files before retrieving their
+                                      extents */
+    uint64_t delalloc_extent_ctr;  /* track the number of delayed allocation
+                                      extents */
     uint8_t excl_streams;          /* zns.fpbench use exclusive streams */
     uint8_t fpbench_streammap;     /* zns.fpbench stream to map file to */
     uint8_t fpbench_streammap_set; /* zns.fpbench indicate if streammap set */
@@ -212,8 +252,9 @@ struct control {
     uint32_t fs_info_bytes;    /* the FS lib must set the size in bytes of the
                                   fs_info in order for memory allocation and copyig
                                   to work correctly */
-    fs_info_cleanup fs_info_cleanup; /* function pointer to cleanup the fs_info
-                                        - free its memory */
+    fs_info_cleanup fs_info_cleanup; /* function pointer to cleanup the fs_info,
+                                        which must not free it, as it is in
+                                        the slab slot of its extent */
 };
 
 extern struct control ctrl;
@@ -227,13 +268,20 @@ extern uint32_t get_nr_zones();
 extern uint32_t get_zone_number(uint64_t);
 extern void cleanup_ctrl();
 extern void cleanup_zonemap();
+extern int update_zone_map();
+extern void sort_zone_map();
 extern void print_zone_info(uint32_t);
-extern int get_extents(char *, int, struct stat *);
+extern int reserve_file_counter_map(uint32_t);
+extern int retrieve_extents(int, struct fiemap_buffer *);
+extern int map_file_extents(char *, struct fiemap_extent *, uint32_t,
+                            uint32_t);
+extern int get_extents(char *, int);
 extern int contains_element(uint32_t[], uint32_t, uint32_t);
 extern void map_extents(struct extent_map *);
 extern void show_extent_flags(uint32_t);
-extern uint32_t get_file_extent_count(char *);
-extern void increase_file_segment_counter(char *, unsigned int, unsigned int,
+extern uint32_t get_file_extent_count(uint32_t);
+extern char *get_file_name(uint32_t);
+extern void increase_file_segment_counter(uint32_t, unsigned int, unsigned int,
                                           void *, uint64_t);
 extern void set_super_block_info(struct f2fs_super_block);
 extern void set_fs_magic(char *);
@@ -260,8 +308,9 @@ extern void print_fiemap_report();
         "----------------------------------------\n");
 
 #define HOLE_FORMATTER                                                         \
-    MSG("-----------------------------------------"                            \
-        "--------------------------------------------------------"             \
-        "--------\n")
+    fputs("-----------------------------------------"                          \
+          "--------------------------------------------------------"           \
+          "--------\n",                                                        \
+          stdout)
 
 #endif
@@ -0,0 +1,92 @@
+#include "csv.h"
+
+/*
+ * Write a field as quoted csv string, doubling quotes in the field, such that
+ * paths with commas, quotes, or newlines stay a single field.
+ *
+ * @fp: FILE * to write to
+ * @str: field to write
+ *
+ * */
+static void csv_write_string(FILE *fp, const char *str) {
+    const char *quote;
+
+    fputc('"', fp);
+    while ((quote = strchr(str, '"')) != NULL) {
+        fwrite(str, 1, quote - str + 1, fp);
+        fputc('"', fp);
+        str = quote + 1;
+    }
+    fputs(str, fp);
+    fputc('"', fp);
+}
+
+static void csv_write_extent(FILE *fp, struct extent *extent,
+                             uint8_t has_segments) {
+    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
+
+    csv_write_string(fp, get_file_name(extent->fileID));
+    fprintf(fp, ",%u,%u,", extent->fileID, extent->zone);
+
+    if (has_segments) {
+        fprintf(fp, "%" PRIu64,
+                (extent->phy_blk & ctrl.f2fs_segment_mask) >>
+                    ctrl.segment_shift);
+    }
+
+    /* the zone map is in LBAs of the device, the csv in 512B sectors */
+    fprintf(fp, ",%" PRIu64 ",%" PRIu64 ",%u,",
+            extent->phy_blk << (ctrl.sector_shift - 9),
+            extent->len << (ctrl.sector_shift - 9), extent->flags);
+
+    if (has_segments && seg_i->type < NO_CHECK_TYPE) {
+        fputs(f2fs_type_name(seg_i->type), fp);
+    }
+
+    fputc('\n', fp);
+}
+
+/*
+ * Write the zone map as csv, one row per extent. The zone map must be updated
+ * and sorted. Rows are streamed from the zone map, such that no copy of the
+ * zone map is built.
+ *
+ * @file: path of the csv file
+ *
+ * */
+void csv_dump_data(char *file) {
+    struct zone *zone;
+    uint8_t has_segments =
+        ctrl.fs_magic == F2FS_MAGIC && ctrl.fs_info_bytes > 0;
+    char *buf;
+    FILE *fp;
+    int err;
+
+    fp = fopen(file, "w");
+    if (!fp) {
+        ERR_MSG("Failed opening csv output file %s\n", file);
+    }
+
+    buf = malloc(CSV_WRITE_BUF_SZ);
+    if (!buf) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    setvbuf(fp, buf, _IOFBF, CSV_WRITE_BUF_SZ);
+
+    fputs(CSV_HEADER, fp);
+
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+
+        for (uint32_t j = 0; j < zone->extent_ctr; j++) {
+            csv_write_extent(fp, zone->extents[j], has_segments);
+        }
+    }
+
+    err = ferror(fp);
+    if (fclose(fp) || err) {
+        ERR_MSG("Failed saving csv data to %s\n", file);
+    }
+
+    free(buf);
+}
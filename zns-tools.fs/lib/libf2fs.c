@@ -1,18 +1,140 @@
 #include "f2fs.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
 struct f2fs_super_block
     f2fs_sb; // TODO move this to the void * to store the super block
 struct f2fs_checkpoint
     f2fs_cp; // TODO: the superblock can hold this info or we can union it
-uint32_t nat_block_offset = 0; /* tracking the nat block traversal */
-uint32_t nat_entry_offset = 0; /* tracking offset to start at in nat_blocks */
+
+/* devices are opened on their first read and kept open until
+ * f2fs_close_devs(), instead of opening the device for each structure */
+static struct f2fs_dev f2fs_devs[MAX_DEVICES];
+static uint8_t f2fs_nr_devs = 0;
+
+/* the active checkpoint pack, which is read once and serves all checkpoint
+ * reads (journals, bitmaps) afterwards */
+static struct f2fs_dev *f2fs_cp_dev = NULL;
+static unsigned char *f2fs_cp_pack = NULL;
+static uint32_t f2fs_cp_addr = 0;
+static uint32_t f2fs_cp_blocks = 0;
+
+/*
+ * Allocate a zeroed buffer that is aligned for direct I/O, which can be freed
+ * with free()
+ *
+ * @size: size of the buffer in bytes
+ *
+ * returns: void * to the buffer
+ *
+ * */
+void *f2fs_alloc_io_buf(size_t size) {
+    void *buf = NULL;
+
+    if (posix_memalign(&buf, F2FS_IO_ALIGN, size) != 0) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    memset(buf, 0, size);
+
+    return buf;
+}
+
+/*
+ * Get the handle of a device, opening the device on first use. Devices are
+ * opened with O_DIRECT, such that reading metadata does not fill the page
+ * cache, or buffered if the device does not support direct I/O.
+ *
+ * @dev_path: char * to the device path
+ *
+ * returns: struct f2fs_dev * of the device, NULL on failure
+ *
+ * */
+static struct f2fs_dev *f2fs_get_dev(char *dev_path) {
+    struct f2fs_dev *dev = NULL;
+
+    for (uint8_t i = 0; i < f2fs_nr_devs; i++) {
+        if (strcmp(f2fs_devs[i].dev_path, dev_path) == 0) {
+            return &f2fs_devs[i];
+        }
+    }
+
+    if (f2fs_nr_devs == MAX_DEVICES) {
+        return NULL;
+    }
+
+    dev = &f2fs_devs[f2fs_nr_devs];
+    dev->direct = 1;
+    dev->fd = open(dev_path, O_RDONLY | O_DIRECT);
+    if (dev->fd < 0) {
+        dev->direct = 0;
+        dev->fd = open(dev_path, O_RDONLY);
+    }
+
+    if (dev->fd < 0) {
+        return NULL;
+    }
+
+    dev->dev_path = strdup(dev_path);
+    f2fs_nr_devs++;
+
+    return dev;
+}
+
+/*
+ * Close all devices opened by libf2fs, and drop the cached checkpoint pack
+ *
+ * */
+void f2fs_close_devs() {
+    for (uint8_t i = 0; i < f2fs_nr_devs; i++) {
+        close(f2fs_devs[i].fd);
+        free(f2fs_devs[i].dev_path);
+    }
+    f2fs_nr_devs = 0;
+
+    free(f2fs_cp_pack);
+    f2fs_cp_pack = NULL;
+    f2fs_cp_dev = NULL;
+    f2fs_cp_blocks = 0;
+}
 
 /*
- * Read a block of specified size from the device
+ * Read from a file descriptor until size bytes are read or the end of the
+ * device is reached
+ *
+ * returns: number of bytes read, -1 on failure
  *
- * @fd: open file descriptor to the device containg the block
+ * */
+static ssize_t f2fs_pread(int fd, void *buf, size_t size, uint64_t offset) {
+    size_t total = 0;
+    ssize_t ret;
+
+    while (total < size) {
+        ret = pread(fd, (unsigned char *)buf + total, size - total,
+                    offset + total);
+        if (ret < 0) {
+            return -1;
+        } else if (ret == 0) {
+            break;
+        }
+        total += ret;
+    }
+
+    return total;
+}
+
+/*
+ * Read a block of specified size from the device. With direct I/O, reads
+ * that are not aligned (e.g., the superblock at a 1KiB offset) are read
+ * through an aligned buffer covering the aligned range.
+ *
+ * @dev: struct f2fs_dev * of the device containg the block
  * @dest: void * to the destination buffer
  * @offset: starting offset to read from
  * @size: size in bytes to read
@@ -20,17 +142,289 @@ uint32_t nat_entry_offset = 0; /* tracking offset to start at in nat_blocks */
  * returns: 1 on success, 0 on Failure
  *
  * */
-static int f2fs_read_block(int fd, void *dest, __u64 offset, size_t size) {
-    if (lseek(fd, offset, SEEK_SET) < 0) {
+static int f2fs_read_block(struct f2fs_dev *dev, void *dest, __u64 offset,
+                           size_t size) {
+    uint64_t start, end;
+    unsigned char *buf = NULL;
+    int fd, ret = 0;
+
+    errno = 0;
+    if (!dev->direct ||
+        (((uintptr_t)dest | offset | size) & (F2FS_IO_ALIGN - 1)) == 0) {
+        ret = f2fs_pread(dev->fd, dest, size, offset) == (ssize_t)size;
+    } else {
+        start = offset & ~(uint64_t)(F2FS_IO_ALIGN - 1);
+        end = (offset + size + F2FS_IO_ALIGN - 1) &
+              ~(uint64_t)(F2FS_IO_ALIGN - 1);
+
+        buf = f2fs_alloc_io_buf(end - start);
+        if (f2fs_pread(dev->fd, buf, end - start, start) >=
+            (ssize_t)(offset + size - start)) {
+            memcpy(dest, buf + (offset - start), size);
+            ret = 1;
+        }
+        free(buf);
+    }
+
+    if (!ret && dev->direct && errno == EINVAL) {
+        /* the device does not support direct I/O, continue buffered */
+        fd = open(dev->dev_path, O_RDONLY);
+        if (fd >= 0) {
+            close(dev->fd);
+            dev->fd = fd;
+            dev->direct = 0;
+
+            return f2fs_read_block(dev, dest, offset, size);
+        }
+    }
+
+    return ret;
+}
+
+/*
+ * Read from a device that libf2fs manages, e.g., to read node blocks outside
+ * of libf2fs without opening the device again.
+ *
+ * @dev_path: char * to the device path
+ * @dest: void * to the destination buffer, allocate with f2fs_alloc_io_buf()
+ * to avoid copying
+ * @offset: starting offset to read from
+ * @size: size in bytes to read
+ *
+ * returns: 1 on success, 0 on failure
+ *
+ * */
+uint8_t f2fs_read_dev(char *dev_path, void *dest, uint64_t offset,
+                      size_t size) {
+    struct f2fs_dev *dev = f2fs_get_dev(dev_path);
+
+    if (dev == NULL) {
         return 0;
     }
 
-    if (read(fd, dest, size) < 0) {
+    return f2fs_read_block(dev, dest, offset, size);
+}
+
+/* the reads of a batch, shared by the threads issuing them */
+struct f2fs_read_pool {
+    struct f2fs_read_req *reqs; /* reads of the batch */
+    int *fds;                   /* fd of the device of each read */
+    uint32_t nr_reqs;           /* number of reads in the batch */
+    uint32_t next;              /* next read to issue */
+};
+
+/*
+ * Issue the reads of a batch from a thread until all reads are issued
+ *
+ * @arg: struct f2fs_read_pool * of the batch
+ *
+ * */
+static void *f2fs_read_worker(void *arg) {
+    struct f2fs_read_pool *pool = (struct f2fs_read_pool *)arg;
+    struct f2fs_read_req *req;
+    uint32_t i;
+
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+           pool->nr_reqs) {
+        req = &pool->reqs[i];
+        req->done = f2fs_pread(pool->fds[i], req->dest, req->size,
+                               req->offset) == (ssize_t)req->size;
+    }
+
+    return NULL;
+}
+
+/*
+ * Issue the reads of a batch with a pool of threads, each with a single
+ * read in flight, such that queue_depth reads are in flight concurrently.
+ * The calling thread is one of the threads.
+ *
+ * @pool: struct f2fs_read_pool * of the batch
+ * @queue_depth: number of reads in flight
+ *
+ * */
+static void f2fs_read_batch_threads(struct f2fs_read_pool *pool,
+                                    uint32_t queue_depth) {
+    pthread_t *threads = NULL;
+    uint32_t nr_threads = 0;
+
+    if (queue_depth > pool->nr_reqs) {
+        queue_depth = pool->nr_reqs;
+    }
+
+    threads = calloc(queue_depth, sizeof(pthread_t));
+    if (threads == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (; nr_threads + 1 < queue_depth; nr_threads++) {
+        if (pthread_create(&threads[nr_threads], NULL, f2fs_read_worker,
+                           pool) != 0) {
+            /* continue with the threads that are running */
+            break;
+        }
+    }
+
+    f2fs_read_worker(pool);
+
+    for (uint32_t i = 0; i < nr_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * Wait for the reads that the kernel still processes before the ring is torn
+ * down, such that no read fills a buffer after it is retried synchronously.
+ * Reads that are queued in the ring but not submitted are never issued.
+ *
+ * @ring: struct io_uring * of the reads
+ * @inflight: number of queued and submitted reads without completion
+ *
+ * */
+static void f2fs_drain_uring(struct io_uring *ring, uint32_t inflight) {
+    struct io_uring_cqe *cqe;
+    struct f2fs_read_req *req;
+    uint32_t submitted = inflight - io_uring_sq_ready(ring);
+    int ret;
+
+    while (submitted > 0) {
+        ret = io_uring_wait_cqe(ring, &cqe);
+        if (ret == -EINTR || ret == -EAGAIN) {
+            continue;
+        } else if (ret < 0) {
+            ERR_MSG("Failed waiting for io_uring reads\n");
+        }
+
+        req = (struct f2fs_read_req *)io_uring_cqe_get_data(cqe);
+        req->done = cqe->res >= 0 && (size_t)cqe->res == req->size;
+        io_uring_cqe_seen(ring, cqe);
+        submitted--;
+    }
+}
+
+/*
+ * Issue the reads of a batch with io_uring, keeping queue_depth reads in
+ * flight.
+ *
+ * @pool: struct f2fs_read_pool * of the batch
+ * @queue_depth: number of reads in flight
+ *
+ * returns: 1 if the reads were issued, 0 if io_uring is not available
+ *
+ * */
+static int f2fs_read_batch_uring(struct f2fs_read_pool *pool,
+                                 uint32_t queue_depth) {
+    struct io_uring ring;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    struct f2fs_read_req *req;
+    uint32_t inflight = 0, i;
+
+    if (io_uring_queue_init(queue_depth, &ring, 0) < 0) {
         return 0;
     }
 
+    while (pool->next < pool->nr_reqs || inflight > 0) {
+        while (inflight < queue_depth && pool->next < pool->nr_reqs) {
+            sqe = io_uring_get_sqe(&ring);
+            if (sqe == NULL) {
+                break;
+            }
+
+            i = pool->next++;
+            io_uring_prep_read(sqe, pool->fds[i], pool->reqs[i].dest,
+                               pool->reqs[i].size, pool->reqs[i].offset);
+            io_uring_sqe_set_data(sqe, &pool->reqs[i]);
+            inflight++;
+        }
+
+        if (io_uring_submit_and_wait(&ring, 1) < 0) {
+            /* reads that did not complete are retried synchronously */
+            f2fs_drain_uring(&ring, inflight);
+            break;
+        }
+
+        while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+            req = (struct f2fs_read_req *)io_uring_cqe_get_data(cqe);
+            req->done = cqe->res >= 0 && (size_t)cqe->res == req->size;
+            io_uring_cqe_seen(&ring, cqe);
+            inflight--;
+        }
+    }
+
+    io_uring_queue_exit(&ring);
+
     return 1;
 }
+#endif
+
+/*
+ * Read a batch of reads from devices that libf2fs manages, with queue_depth
+ * reads in flight concurrently. Reads are issued with io_uring if zns-tools
+ * is built with liburing, and with a pool of threads otherwise. Reads that
+ * fail (e.g., reads that are not aligned for direct I/O) are retried
+ * synchronously.
+ *
+ * @reqs: struct f2fs_read_req * array of reads
+ * @nr_reqs: number of reads in the array
+ * @queue_depth: number of reads in flight
+ *
+ * returns: number of completed reads, reqs[i].done is set for each read
+ *
+ * */
+uint32_t f2fs_read_dev_batch(struct f2fs_read_req *reqs, uint32_t nr_reqs,
+                             uint32_t queue_depth) {
+    struct f2fs_read_pool pool = {0};
+    struct f2fs_dev *dev = NULL;
+    uint32_t nr_done = 0;
+
+    if (nr_reqs == 0) {
+        return 0;
+    }
+
+    if (queue_depth == 0) {
+        queue_depth = 1;
+    }
+
+    pool.reqs = reqs;
+    pool.nr_reqs = nr_reqs;
+    pool.fds = calloc(nr_reqs, sizeof(int));
+    if (pool.fds == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    /* devices are opened before issuing the reads, the threads do not
+     * modify the device handles */
+    for (uint32_t i = 0; i < nr_reqs; i++) {
+        dev = f2fs_get_dev(reqs[i].dev_path);
+        pool.fds[i] = dev == NULL ? -1 : dev->fd;
+        reqs[i].done = 0;
+    }
+
+#ifdef HAVE_LIBURING
+    if (!f2fs_read_batch_uring(&pool, queue_depth)) {
+        f2fs_read_batch_threads(&pool, queue_depth);
+    }
+#else
+    f2fs_read_batch_threads(&pool, queue_depth);
+#endif
+
+    for (uint32_t i = 0; i < nr_reqs; i++) {
+        if (!reqs[i].done && pool.fds[i] >= 0) {
+            dev = f2fs_get_dev(reqs[i].dev_path);
+            reqs[i].done = f2fs_read_block(dev, reqs[i].dest, reqs[i].offset,
+                                           reqs[i].size);
+        }
+        nr_done += reqs[i].done;
+    }
+
+    free(pool.fds);
+
+    return nr_done;
+}
 
 /*
  * Read the superblock from the provided device
@@ -41,19 +435,16 @@ static int f2fs_read_block(int fd, void *dest, __u64 offset, size_t size) {
  *
  * */
 void f2fs_read_super_block(char *dev_path) {
-    int fd;
+    struct f2fs_dev *dev = f2fs_get_dev(dev_path);
 
-    fd = open(dev_path, O_RDONLY);
-    if (fd < 0) {
+    if (dev == NULL) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    if (!f2fs_read_block(fd, &f2fs_sb, F2FS_SUPER_OFFSET,
+    if (!f2fs_read_block(dev, &f2fs_sb, F2FS_SUPER_OFFSET,
                          sizeof(struct f2fs_super_block))) {
         ERR_MSG("reading superblock from %s\n", dev_path);
     }
-
-    close(fd);
 }
 
 /*
@@ -126,23 +517,219 @@ void f2fs_show_super_block() {
 }
 
 /*
- * Read the F2FS checkpoint into the global f2fs_cp variable
+ * Calculate the CRC32 checksum of F2FS metadata blocks, which is the little
+ * endian CRC32 seeded with the F2FS magic and without final inversion.
+ *
+ * @buf: void * to the data to checksum
+ * @len: size of the data in bytes
+ *
+ * returns: uint32_t checksum of the data
  *
  * */
-void f2fs_read_checkpoint(char *dev_path) {
-    int fd;
+static uint32_t f2fs_crc32(const void *buf, size_t len) {
+    const unsigned char *p = (const unsigned char *)buf;
+    uint32_t crc = F2FS_SUPER_MAGIC;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+        }
+    }
 
-    fd = open(dev_path, O_RDONLY);
-    if (fd < 0) {
-        ERR_MSG("opening device fd for %s\n", dev_path);
+    return crc;
+}
+
+/*
+ * Check the checksum of a checkpoint block, stored at its checksum_offset.
+ *
+ * @cp_block: struct f2fs_checkpoint * to the BLOCK_SZ checkpoint block
+ *
+ * returns: 1 if the checksum is valid, else 0
+ *
+ * */
+static uint8_t f2fs_cp_crc_valid(struct f2fs_checkpoint *cp_block) {
+    uint32_t crc_offset = cp_block->checksum_offset;
+    uint32_t crc;
+
+    if (crc_offset < CP_MIN_CHKSUM_OFFSET || crc_offset > CP_CHKSUM_OFFSET) {
+        return 0;
     }
 
-    if (!f2fs_read_block(fd, &f2fs_cp, f2fs_sb.cp_blkaddr << F2FS_BLKSIZE_BITS,
-                         sizeof(struct f2fs_checkpoint))) {
-        ERR_MSG("reading checkpoint from %s\n", dev_path);
+    memcpy(&crc, (unsigned char *)cp_block + crc_offset, sizeof(uint32_t));
+
+    return f2fs_crc32(cp_block, crc_offset) == crc;
+}
+
+/*
+ * Read a checkpoint pack and check that it is complete. A pack is only valid
+ * if its first and last block have a valid checksum and the same checkpoint
+ * version, otherwise writing the pack was interrupted and F2FS uses the
+ * other pack. The first F2FS_CP_READ_BLOCKS blocks of the pack, which
+ * usually hold the entire pack, are read with a single read.
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_addr: block address of the checkpoint pack
+ * @nr_blocks: set to the number of blocks that were read
+ * @valid: set to 1 if the checkpoint pack is valid, else 0
+ *
+ * returns: unsigned char * to the blocks of the pack, starting with the
+ * checkpoint block
+ *
+ * */
+static unsigned char *f2fs_read_cp_pack(struct f2fs_dev *dev, uint32_t cp_addr,
+                                        uint32_t *nr_blocks, uint8_t *valid) {
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t read_blocks = F2FS_CP_READ_BLOCKS, pack_blocks;
+    struct f2fs_checkpoint *cp_block = NULL, *cp_tail = NULL;
+    unsigned char *pack = NULL, *temp = NULL;
+
+    if (read_blocks > blocks_per_seg) {
+        read_blocks = blocks_per_seg;
     }
 
-    close(fd);
+    *valid = 0;
+    pack = f2fs_alloc_io_buf((size_t)read_blocks * BLOCK_SZ);
+    if (!f2fs_read_block(dev, pack, (uint64_t)cp_addr << F2FS_BLKSIZE_BITS,
+                         (size_t)read_blocks * BLOCK_SZ)) {
+        ERR_MSG("reading checkpoint pack at %#x\n", cp_addr);
+    }
+    *nr_blocks = read_blocks;
+
+    cp_block = (struct f2fs_checkpoint *)pack;
+    pack_blocks = cp_block->cp_pack_total_block_count;
+    if (!f2fs_cp_crc_valid(cp_block) || pack_blocks == 0 ||
+        pack_blocks > blocks_per_seg) {
+        return pack;
+    }
+
+    if (pack_blocks > read_blocks) {
+        temp = f2fs_alloc_io_buf((size_t)pack_blocks * BLOCK_SZ);
+        memcpy(temp, pack, (size_t)read_blocks * BLOCK_SZ);
+        free(pack);
+        pack = temp;
+        cp_block = (struct f2fs_checkpoint *)pack;
+
+        if (!f2fs_read_block(
+                dev, pack + (size_t)read_blocks * BLOCK_SZ,
+                (uint64_t)(cp_addr + read_blocks) << F2FS_BLKSIZE_BITS,
+                (size_t)(pack_blocks - read_blocks) * BLOCK_SZ)) {
+            return pack;
+        }
+        *nr_blocks = pack_blocks;
+    }
+
+    cp_tail =
+        (struct f2fs_checkpoint *)&pack[(size_t)(pack_blocks - 1) * BLOCK_SZ];
+    *valid = f2fs_cp_crc_valid(cp_tail) &&
+             cp_tail->checkpoint_ver == cp_block->checkpoint_ver;
+
+    return pack;
+}
+
+/*
+ * Get the active checkpoint pack. F2FS alternates between two checkpoint
+ * packs, located in the first two segments of the checkpoint area, of which
+ * the valid pack with the higher checkpoint version is the active one. The
+ * active pack is read once and cached until f2fs_close_devs().
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_addr: set to the block address of the active checkpoint pack
+ *
+ * returns: struct f2fs_checkpoint * to the cached checkpoint block
+ *
+ * */
+static struct f2fs_checkpoint *f2fs_read_active_cp(struct f2fs_dev *dev,
+                                                   uint32_t *cp_addr) {
+    struct f2fs_checkpoint *cp_block = NULL, *cp2_block = NULL;
+    uint32_t cp2_addr;
+    uint32_t cp_blocks, cp2_blocks;
+    uint8_t cp_valid, cp2_valid;
+    unsigned char *cp_pack = NULL, *cp2_pack = NULL;
+
+    if (f2fs_cp_pack != NULL && f2fs_cp_dev == dev) {
+        *cp_addr = f2fs_cp_addr;
+        return (struct f2fs_checkpoint *)f2fs_cp_pack;
+    }
+
+    *cp_addr = f2fs_sb.cp_blkaddr;
+    cp2_addr = *cp_addr + (1 << f2fs_sb.log_blocks_per_seg);
+
+    cp_pack = f2fs_read_cp_pack(dev, *cp_addr, &cp_blocks, &cp_valid);
+    cp2_pack = f2fs_read_cp_pack(dev, cp2_addr, &cp2_blocks, &cp2_valid);
+    cp_block = (struct f2fs_checkpoint *)cp_pack;
+    cp2_block = (struct f2fs_checkpoint *)cp2_pack;
+
+    if (!cp_valid && !cp2_valid) {
+        WARN("No valid checkpoint pack, using the pack with the higher "
+             "version\n");
+        cp_valid = 1;
+        cp2_valid = 1;
+    }
+
+    if (cp2_valid &&
+        (!cp_valid || cp2_block->checkpoint_ver > cp_block->checkpoint_ver)) {
+        free(cp_pack);
+        cp_pack = cp2_pack;
+        cp_blocks = cp2_blocks;
+        *cp_addr = cp2_addr;
+    } else {
+        free(cp2_pack);
+    }
+
+    free(f2fs_cp_pack);
+    f2fs_cp_dev = dev;
+    f2fs_cp_pack = cp_pack;
+    f2fs_cp_addr = *cp_addr;
+    f2fs_cp_blocks = cp_blocks;
+
+    return (struct f2fs_checkpoint *)f2fs_cp_pack;
+}
+
+/*
+ * Read blocks of the active checkpoint pack, from the cached pack if they
+ * were read with it, and from the device otherwise.
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @blk_addr: block address to read from
+ * @dest: void * to the destination buffer
+ * @size: size in bytes to read
+ *
+ * returns: 1 on success, 0 on failure
+ *
+ * */
+static int f2fs_read_cp_blocks(struct f2fs_dev *dev, uint32_t blk_addr,
+                               void *dest, size_t size) {
+    uint64_t off;
+
+    if (f2fs_cp_pack != NULL && f2fs_cp_dev == dev &&
+        blk_addr >= f2fs_cp_addr) {
+        off = (uint64_t)(blk_addr - f2fs_cp_addr) << F2FS_BLKSIZE_BITS;
+        if (off + size <= (uint64_t)f2fs_cp_blocks << F2FS_BLKSIZE_BITS) {
+            memcpy(dest, f2fs_cp_pack + off, size);
+            return 1;
+        }
+    }
+
+    return f2fs_read_block(dev, dest, (uint64_t)blk_addr << F2FS_BLKSIZE_BITS,
+                           size);
+}
+
+/*
+ * Read the F2FS checkpoint of the active checkpoint pack into the global
+ * f2fs_cp variable
+ *
+ * */
+void f2fs_read_checkpoint(char *dev_path) {
+    struct f2fs_dev *dev = f2fs_get_dev(dev_path);
+    uint32_t cp_addr;
+
+    if (dev == NULL) {
+        ERR_MSG("opening device fd for %s\n", dev_path);
+    }
+
+    memcpy(&f2fs_cp, f2fs_read_active_cp(dev, &cp_addr),
+           sizeof(struct f2fs_checkpoint));
 }
 
 /*
@@ -204,83 +791,277 @@ void f2fs_show_checkpoint() {
 }
 
 /*
- *  Get the NAT entry for an inode
+ * Read the checkpoint block and its payload blocks into a single buffer, as
+ * the kernel does in f2fs_get_valid_checkpoint(). The version bitmaps of the
+ * NAT and SIT start in the checkpoint block and can continue into the payload
+ * blocks.
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_addr: block address of the active checkpoint pack
+ * @size: set to the size of the buffer in bytes
+ *
+ * returns: unsigned char * to the allocated buffer, NULL on failure
+ *
+ * */
+static unsigned char *f2fs_read_cp_area(struct f2fs_dev *dev, uint32_t cp_addr,
+                                        size_t *size) {
+    unsigned char *area = NULL;
+
+    if (f2fs_sb.cp_payload >= (1U << f2fs_sb.log_blocks_per_seg)) {
+        return NULL;
+    }
+
+    *size = (size_t)(1 + f2fs_sb.cp_payload) * BLOCK_SZ;
+    area = malloc(*size);
+    if (area == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    if (!f2fs_read_cp_blocks(dev, cp_addr, area, *size)) {
+        free(area);
+        return NULL;
+    }
+
+    return area;
+}
+
+/*
+ * Get a version bitmap of the checkpoint, which indicates for each NAT or SIT
+ * block which of its two copies is valid, with the layout of __bitmap_ptr()
+ * in the kernel.
  *
- *  @dev_path: device path where the NAT is on
- *  @inode_number: inode number to locate
+ * @cp_area: checkpoint block and payload blocks from f2fs_read_cp_area()
+ * @size: size of cp_area in bytes
+ * @sit: 1 for the SIT bitmap, 0 for the NAT bitmap
  *
- *  Note, this function tracks offsets to begin it, in the case where the
- * returned NAT entry is not an inode. Hence, it can be called again and will
- * return the next NAT entry for this inode number.
+ * returns: unsigned char * to the bitmap in cp_area, NULL if the bitmap does
+ * not fit in cp_area
  *
- * returns: f2fs_nat_entry * with the NAT entry
- *  */
-struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *dev_path,
-                                                uint32_t inode_number) {
-    int fd;
+ * */
+static unsigned char *f2fs_cp_bitmap(unsigned char *cp_area, size_t size,
+                                     uint8_t sit) {
+    struct f2fs_checkpoint *cp_block = (struct f2fs_checkpoint *)cp_area;
+    uint64_t off = offsetof(struct f2fs_checkpoint, sit_nat_version_bitmap);
+    uint64_t bitmap_size = sit ? cp_block->sit_ver_bitmap_bytesize
+                               : cp_block->nat_ver_bitmap_bytesize;
+
+    if (cp_block->ckpt_flags & CP_LARGE_NAT_BITMAP_FLAG) {
+        /* bitmaps are preceded by their checksum, the SIT bitmap follows the
+         * NAT bitmap */
+        off += sizeof(__le32);
+        if (sit) {
+            off += cp_block->nat_ver_bitmap_bytesize;
+        }
+    } else if (f2fs_sb.cp_payload > 0) {
+        /* the SIT bitmap is in the payload blocks after the checkpoint block */
+        if (sit) {
+            off = BLOCK_SZ;
+        }
+    } else if (!sit) {
+        off += cp_block->sit_ver_bitmap_bytesize;
+    }
+
+    if (off + bitmap_size > size) {
+        return NULL;
+    }
+
+    return cp_area + off;
+}
+
+/*
+ * Read the summary block of a current data segment from the checkpoint pack
+ * and locate the journal in it. The NAT journal is kept in the summary of the
+ * current hot data segment, and the SIT journal in the summary of the current
+ * cold data segment.
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_block: struct f2fs_checkpoint * to the active checkpoint block
+ * @cp_addr: block address of the active checkpoint pack
+ * @type: CURSEG_HOT_DATA for the NAT journal, CURSEG_COLD_DATA for the SIT
+ * journal
+ * @sum_block: BLOCK_SZ buffer to read the summary block into
+ *
+ * returns: struct f2fs_journal * into sum_block
+ *
+ * */
+static struct f2fs_journal *f2fs_read_journal(struct f2fs_dev *dev,
+                                              struct f2fs_checkpoint *cp_block,
+                                              uint32_t cp_addr, enum type type,
+                                              unsigned char *sum_block) {
+    uint32_t sum_addr, journal_off;
+
+    if (cp_block->ckpt_flags & CP_COMPACT_SUM_FLAG) {
+        /* compacted summaries start with the NAT journal, followed by the
+         * SIT journal */
+        sum_addr = cp_addr + cp_block->cp_pack_start_sum;
+        journal_off = type == CURSEG_HOT_DATA ? 0 : SUM_JOURNAL_SIZE;
+    } else {
+        /* summary blocks of the data segments are at the end of the pack,
+         * followed by the node summaries if these are included */
+        if (cp_block->ckpt_flags & (CP_UMOUNT_FLAG | CP_FASTBOOT_FLAG)) {
+            sum_addr = cp_addr + cp_block->cp_pack_total_block_count -
+                       (NR_CURSEG_TYPE + 1) + type;
+        } else {
+            sum_addr = cp_addr + cp_block->cp_pack_total_block_count -
+                       (NR_CURSEG_DATA_TYPE + 1) + type;
+        }
+        journal_off = SUM_ENTRY_SIZE;
+    }
+
+    if (!f2fs_read_cp_blocks(dev, sum_addr, sum_block, BLOCK_SZ)) {
+        ERR_MSG("reading journal at %#" PRIx32 "\n", sum_addr);
+    }
+
+    return (struct f2fs_journal *)&sum_block[journal_off];
+}
+
+/*
+ * Apply the NAT journal of the checkpoint pack to the NAT index. Recently
+ * updated NAT entries are journaled in the summary of the current hot data
+ * segment and are more recent than the entries in the NAT blocks.
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_block: struct f2fs_checkpoint * to the active checkpoint block
+ * @cp_addr: block address of the active checkpoint pack
+ * @nat: struct f2fs_nat_index * to apply the journal to
+ *
+ * */
+static void f2fs_read_nat_journal(struct f2fs_dev *dev,
+                                  struct f2fs_checkpoint *cp_block,
+                                  uint32_t cp_addr,
+                                  struct f2fs_nat_index *nat) {
+    struct nat_journal_entry *entry;
+    struct f2fs_journal *journal;
+    unsigned char *sum_block;
+    uint16_t n_nats;
+
+    sum_block = calloc(1, BLOCK_SZ);
+    journal =
+        f2fs_read_journal(dev, cp_block, cp_addr, CURSEG_HOT_DATA, sum_block);
+
+    n_nats = journal->n_nats;
+    if (n_nats > NAT_JOURNAL_ENTRIES) {
+        n_nats = NAT_JOURNAL_ENTRIES;
+    }
+
+    for (uint16_t i = 0; i < n_nats; i++) {
+        entry = &journal->nat_j.entries[i];
+        if (entry->nid < nat->nr_nids) {
+            memcpy(&nat->entries[entry->nid], &entry->ne,
+                   sizeof(struct f2fs_nat_entry));
+        }
+    }
+
+    free(sum_block);
+}
+
+/*
+ * Load the NAT into memory, indexed by nid. The NAT consists of segment
+ * pairs, of which each NAT block is valid in either the first or the second
+ * segment of its pair, as indicated by the NAT version bitmap of the active
+ * checkpoint. Each segment pair is read with a single sequential read, and
+ * the entries of the NAT journal are applied on top.
+ *
+ * @dev_path: device path where the NAT is on
+ *
+ * returns: struct f2fs_nat_index * with the NAT entries of all nids
+ *
+ * */
+struct f2fs_nat_index *f2fs_load_nat_index(char *dev_path) {
+    struct f2fs_dev *dev = NULL;
     uint32_t nat_segments = 0;
     uint32_t nat_blocks = 0;
-    uint64_t cur_nat_blkaddress;
-    struct f2fs_nat_block *nat_block = NULL;
-    struct f2fs_nat_entry *nat_entry = NULL;
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t cp_addr, block_off, src_blk;
+    uint64_t seg_pair_addr;
+    unsigned char *nat_bitmap = NULL, *seg_pair = NULL, *cp_area = NULL;
+    struct f2fs_checkpoint *cp_block = NULL;
+    struct f2fs_nat_index *nat = NULL;
+    size_t cp_size;
 
     /* from:f2fs.tools mount.c:1680
      * segment_count_nat includes pair segment so divide to 2. */
     nat_segments = f2fs_sb.segment_count_nat >> 1;
     nat_blocks = nat_segments << f2fs_sb.log_blocks_per_seg;
 
-    nat_block = (struct f2fs_nat_block *)calloc(1, BLOCK_SZ);
-    nat_entry =
-        (struct f2fs_nat_entry *)calloc(1, sizeof(struct f2fs_nat_entry));
+    nat = calloc(1, sizeof(struct f2fs_nat_index) +
+                        sizeof(struct f2fs_nat_entry) * nat_blocks *
+                            NAT_ENTRY_PER_BLOCK);
+    if (nat == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    nat->nr_nids = nat_blocks * NAT_ENTRY_PER_BLOCK;
 
-    fd = open(dev_path, O_RDONLY);
-    if (fd < 0) {
+    dev = f2fs_get_dev(dev_path);
+    if (dev == NULL) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    for (uint32_t i = 0; i < nat_blocks; i++) {
-        cur_nat_blkaddress = (f2fs_sb.nat_blkaddr << F2FS_BLKSIZE_BITS) +
-                             (nat_block_offset * BLOCK_SZ);
-
-        if (!f2fs_read_block(fd, nat_block, cur_nat_blkaddress, BLOCK_SZ)) {
-            ERR_MSG("reading NAT Block %#" PRIx64 " from %s\n",
-                    cur_nat_blkaddress, dev_path);
-        }
-
-        for (uint32_t i = nat_entry_offset; i < NAT_ENTRY_PER_BLOCK; i++) {
-            if (nat_block->entries[i].ino == inode_number) {
-                // Next time we check nat entries, we need to start at differnet
-                // locations
-                if (i == NAT_ENTRY_PER_BLOCK - 1) {
-                    /* If we are at the last entry in the nat block, start at
-                     * the next block */
-                    nat_block_offset++;
-                    nat_entry_offset = 0;
-                } else {
-                    /* if we are in the nat block, start at the next nat entry
-                     * in this block */
-                    nat_entry_offset = i + 1;
-                }
-                nat_entry->version = nat_block->entries[i].version;
-                nat_entry->ino = nat_block->entries[i].ino;
-                nat_entry->block_addr = nat_block->entries[i].block_addr;
+    cp_block = f2fs_read_active_cp(dev, &cp_addr);
+    cp_area = f2fs_read_cp_area(dev, cp_addr, &cp_size);
+    if (cp_area == NULL) {
+        ERR_MSG("reading checkpoint blocks from %s\n", dev_path);
+    }
+
+    nat_bitmap = f2fs_cp_bitmap(cp_area, cp_size, 0);
+    if (nat_bitmap == NULL) {
+        ERR_MSG("Invalid NAT version bitmap in the checkpoint\n");
+    }
+    if ((uint64_t)cp_block->nat_ver_bitmap_bytesize * 8 < nat_blocks) {
+        ERR_MSG("NAT version bitmap is too small for %u NAT blocks\n",
+                nat_blocks);
+    }
+
+    seg_pair = f2fs_alloc_io_buf((size_t)BLOCK_SZ * blocks_per_seg * 2);
+
+    for (uint32_t seg_off = 0; seg_off < nat_segments; seg_off++) {
+        seg_pair_addr = (uint64_t)f2fs_sb.nat_blkaddr +
+                        ((uint64_t)seg_off << f2fs_sb.log_blocks_per_seg << 1);
 
-                close(fd);
-                free(nat_block);
+        if (!f2fs_read_block(dev, seg_pair, seg_pair_addr << F2FS_BLKSIZE_BITS,
+                             (size_t)BLOCK_SZ * blocks_per_seg * 2)) {
+            ERR_MSG("reading NAT Segment %#" PRIx64 " from %s\n",
+                    seg_pair_addr, dev_path);
+        }
 
-                return nat_entry;
+        for (uint32_t blk = 0; blk < blocks_per_seg; blk++) {
+            block_off = (seg_off << f2fs_sb.log_blocks_per_seg) + blk;
+            src_blk = blk;
+            if (f2fs_test_bit(block_off, nat_bitmap)) {
+                src_blk += blocks_per_seg;
             }
+
+            memcpy(&nat->entries[block_off * NAT_ENTRY_PER_BLOCK],
+                   &seg_pair[(size_t)src_blk * BLOCK_SZ],
+                   sizeof(struct f2fs_nat_block));
         }
-        nat_block_offset++;
-        nat_entry_offset = 0;
     }
 
-    close(fd);
-    free(nat_block);
+    f2fs_read_nat_journal(dev, cp_block, cp_addr, nat);
 
-    free(nat_entry);
+    free(seg_pair);
+    free(cp_area);
 
-    return NULL;
+    return nat;
+}
+
+/*
+ * Get the NAT entry of a nid. The nid of an inode is its inode number.
+ *
+ * @nat: struct f2fs_nat_index * loaded with f2fs_load_nat_index()
+ * @nid: node id to get the NAT entry for
+ *
+ * returns: struct f2fs_nat_entry * in the index, NULL if the nid is invalid
+ * or has no block address
+ *
+ * */
+struct f2fs_nat_entry *f2fs_get_nat_entry(struct f2fs_nat_index *nat,
+                                          uint32_t nid) {
+    if (nid >= nat->nr_nids || nat->entries[nid].block_addr == 0) {
+        return NULL;
+    }
+
+    return &nat->entries[nid];
 }
 
 /*
@@ -295,26 +1076,71 @@ struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *dev_path,
  * */
 struct f2fs_node *f2fs_get_node_block(char *dev_path, uint32_t block_addr) {
     struct f2fs_node *node_block = NULL;
-    int fd;
+    struct f2fs_dev *dev = NULL;
 
-    node_block = (struct f2fs_node *)calloc(sizeof(struct f2fs_node), 1);
+    node_block = f2fs_alloc_io_buf(sizeof(struct f2fs_node));
 
-    fd = open(dev_path, O_RDONLY);
-    if (fd < 0) {
+    dev = f2fs_get_dev(dev_path);
+    if (dev == NULL) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    if (!f2fs_read_block(fd, node_block, block_addr << F2FS_BLKSIZE_BITS,
+    if (!f2fs_read_block(dev, node_block,
+                         (uint64_t)block_addr << F2FS_BLKSIZE_BITS,
                          sizeof(struct f2fs_node))) {
         ERR_MSG("reading NAT Block %#" PRIx32 " from %s\n", block_addr,
                 dev_path);
     }
 
-    close(fd);
-
     return node_block;
 }
 
+/*
+ * Read the summary blocks of a range of main area segments from the Segment
+ * Summary Area (SSA), which holds for each block of a segment the nid of the
+ * node owning it. For data segments this is the direct node or inode pointing
+ * to the block, for node segments the nid of the node itself. The summary
+ * blocks of the range are read with a single read.
+ *
+ * Note, the summaries of the current segments are kept in the checkpoint and
+ * only written to the SSA when the segment is changed.
+ *
+ * @dev_path: device path where the SSA is on
+ * @segno: first main area segment of the range
+ * @nr_segments: number of segments in the range
+ *
+ * returns: struct f2fs_summary_block * array with nr_segments entries, NULL if
+ * the range is outside of the main area
+ *
+ * */
+struct f2fs_summary_block *f2fs_read_ssa(char *dev_path, uint32_t segno,
+                                         uint32_t nr_segments) {
+    struct f2fs_summary_block *sum_blocks = NULL;
+    struct f2fs_dev *dev = NULL;
+
+    if (segno >= f2fs_sb.segment_count_main ||
+        nr_segments > f2fs_sb.segment_count_main - segno) {
+        return NULL;
+    }
+
+    sum_blocks = f2fs_alloc_io_buf(sizeof(struct f2fs_summary_block) *
+                                   nr_segments);
+
+    dev = f2fs_get_dev(dev_path);
+    if (dev == NULL) {
+        ERR_MSG("opening device fd for %s\n", dev_path);
+    }
+
+    if (!f2fs_read_block(dev, sum_blocks,
+                         (uint64_t)(f2fs_sb.ssa_blkaddr + segno)
+                             << F2FS_BLKSIZE_BITS,
+                         sizeof(struct f2fs_summary_block) * nr_segments)) {
+        ERR_MSG("reading SSA of segment %u from %s\n", segno, dev_path);
+    }
+
+    return sum_blocks;
+}
+
 /*
  * show detailed info about the inode fadvise flags
  *
@@ -430,104 +1256,453 @@ void f2fs_show_inode_info(struct f2fs_inode *inode) {
 }
 
 /*
- * Get the segment data from /proc/fs/f2fs/<device>/segment_bits
- * for more information about segments. Only get up to the highest
- * segment number we care about in our mappings, limit runtime and
- * memory consumption. It sets the global sm_info struct
+ * Parse the contents of /proc/fs/f2fs/<device>/segment_info into the segment
+ * manager. After two lines describing the format, each line starts with the
+ * number of its first segment, followed by up to 10 "type|valid blocks"
+ * entries of consecutive segments. The file is parsed in a single pass over
+ * large reads, with a state machine that carries numbers across reads, such
+ * that it does not allocate memory or split lines.
  *
- * @dev_name: * to device name F2FS is registered on
- * number segment)
+ * @fd: open file descriptor to the segment_info file
+ * @highest_segment: number of segments in segman, entries of higher segments
+ * are ignored
+ * @segman: struct segment_manager * to fill
  *
- * TODO: update docs
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE on a read error
  *
  * */
-static int init_procfs_segment_bits(char *dev_name, uint32_t highest_segment,
-                                    struct segment_manager *segman) {
-    FILE *fp;
-    char path[50];
-    char *device, *dev_string, *dev, *line;
-    size_t len = 0;
-    uint32_t line_ctr = 0;
-    ssize_t read;
+static int f2fs_parse_segment_info(int fd, uint32_t highest_segment,
+                                   struct segment_manager *segman) {
+    char buf[PROCFS_READ_BYTES];
+    enum { FIELD_SEGNO, FIELD_TYPE, FIELD_VALID } field = FIELD_SEGNO;
+    uint32_t header_lines = 0;
+    uint32_t val = 0, type = 0, segno = 0, line_segno = 0;
+    uint8_t in_num = 0;
+    ssize_t len;
+    char c;
+
+    while ((len = read(fd, buf, PROCFS_READ_BYTES)) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            c = buf[i];
+
+            // Skip first 2 lines that show file format
+            if (header_lines < 2) {
+                if (c == '\n') {
+                    header_lines++;
+                }
+                continue;
+            }
+
+            if (c >= '0' && c <= '9') {
+                val = val * 10 + (c - '0');
+                in_num = 1;
+                continue;
+            }
+
+            if (c == '|') {
+                type = val;
+                field = FIELD_VALID;
+            } else if (in_num) {
+                if (field == FIELD_SEGNO) {
+                    line_segno = val;
+                    field = FIELD_TYPE;
+                } else if (field == FIELD_VALID) {
+                    if (line_segno < highest_segment) {
+                        segman->segments[line_segno].id = line_segno;
+                        segman->segments[line_segno].type = type;
+                        segman->segments[line_segno].valid_blocks = val;
+                        segno = line_segno + 1;
+                    }
+                    line_segno++;
+                    field = FIELD_TYPE;
+                }
+            }
 
-    dev_string = strdup(dev_name);
-    while ((device = strsep(&dev_string, "/")) != NULL) {
-        dev = device;
+            if (c == '\n') {
+                field = FIELD_SEGNO;
+            }
+            val = 0;
+            in_num = 0;
+        }
     }
 
-    sprintf(path, "/proc/fs/f2fs/%s/segment_info", dev);
+    segman->nr_segments = segno;
 
-    fp = fopen(path, "r");
-    if (!fp) {
+    return len < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Get the segment information from /proc/fs/f2fs/<device>/segment_info,
+ * which is only available if the kernel is built with F2FS debugging.
+ *
+ * @dev_path: device path F2FS is registered on
+ * @highest_segment: number of segments in segman
+ * @segman: struct segment_manager * to fill
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if segment_info cannot be read
+ *
+ * */
+static int init_procfs_segment_bits(char *dev_path, uint32_t highest_segment,
+                                    struct segment_manager *segman) {
+    char path[MAX_PATH_LEN];
+    char *dev;
+    int fd, ret;
+
+    dev = strrchr(dev_path, '/');
+    dev = dev ? dev + 1 : dev_path;
+    snprintf(path, MAX_PATH_LEN, "/proc/fs/f2fs/%s/segment_info", dev);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
         WARN("Failed opening %s\nEnsure Kernel is running with F2FS Debugging "
              "enabled.\nFalling back to disabling procfs segment resolving.\n",
              path);
-        free(dev_string);
         return EXIT_FAILURE;
     }
 
-    while ((read = getline(&line, &len, fp)) != -1) {
-        // Skip first 2 lines that show file format
-        if (line_ctr < 2) {
-            line_ctr++;
+    ret = f2fs_parse_segment_info(fd, highest_segment, segman);
+    if (ret == EXIT_FAILURE) {
+        WARN("Failed reading %s\n", path);
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+/*
+ * Get the valid block bitmaps of the segments from
+ * /proc/fs/f2fs/<device>/segment_bits, of which each line holds the segment
+ * number, its type and valid block count, and the bytes of its bitmap in hex.
+ *
+ * @dev_path: device path F2FS is registered on
+ * @segman: struct segment_manager * with allocated valid_maps
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if segment_bits cannot be read
+ *
+ * */
+static int init_procfs_valid_maps(char *dev_path,
+                                  struct segment_manager *segman) {
+    FILE *fp;
+    char path[MAX_PATH_LEN];
+    char *dev, *line = NULL, *pos;
+    unsigned char *valid_map;
+    size_t len = 0;
+    unsigned long segno;
+
+    dev = strrchr(dev_path, '/');
+    dev = dev ? dev + 1 : dev_path;
+    snprintf(path, MAX_PATH_LEN, "/proc/fs/f2fs/%s/segment_bits", dev);
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return EXIT_FAILURE;
+    }
+
+    while (getline(&line, &len, fp) != -1) {
+        /* skips the lines describing the format, which have no segment
+         * number */
+        segno = strtoul(line, &pos, 10);
+        if (pos == line || segno >= segman->nr_segments) {
             continue;
         }
 
-        char *contents;
-        while ((contents = strsep(&line, " \t"))) {
-            if (strchr(contents, '|')) {
-                char *split_string;
-                uint8_t set_first = 0;
-                // sscanf had issues, resort to manual work
-                while ((split_string = strsep(&contents, "|"))) {
-                    if (strcmp(split_string, "|") == 0) {
-                        continue;
-                    } else if (!set_first) {
-                        segman->segments[segman->nr_segments].type =
-                            atoi(split_string);
-                        set_first = 1;
-                    } else {
-                        segman->segments[segman->nr_segments].valid_blocks =
-                            atoi(split_string);
-                    }
-                }
+        /* the bitmap follows the "type|valid blocks|" of the segment */
+        pos = strchr(pos, '|');
+        if (!pos || !(pos = strchr(pos + 1, '|'))) {
+            continue;
+        }
+        pos++;
+
+        valid_map = &segman->valid_maps[segno * SIT_VBLOCK_MAP_SIZE];
+        for (uint32_t i = 0; i < SIT_VBLOCK_MAP_SIZE; i++) {
+            valid_map[i] = strtoul(pos, &pos, 16);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Get the SIT version bitmap of the checkpoint, which indicates for each SIT
+ * block which of its two copies is valid
+ *
+ * @dev: struct f2fs_dev * of the device containing the checkpoint
+ * @cp_block: struct f2fs_checkpoint * to the active checkpoint block
+ * @cp_addr: block address of the active checkpoint pack
+ *
+ * returns: unsigned char * to an allocated copy of the bitmap, NULL on failure
+ *
+ * */
+static unsigned char *f2fs_read_sit_bitmap(struct f2fs_dev *dev,
+                                           struct f2fs_checkpoint *cp_block,
+                                           uint32_t cp_addr) {
+    unsigned char *sit_bitmap = NULL, *cp_area = NULL, *bitmap = NULL;
+    uint32_t bitmap_size = cp_block->sit_ver_bitmap_bytesize;
+    size_t cp_size;
+
+    /* the SIT bitmap can continue from the checkpoint block into the payload
+     * blocks, e.g., after a large NAT bitmap */
+    cp_area = f2fs_read_cp_area(dev, cp_addr, &cp_size);
+    if (cp_area == NULL) {
+        return NULL;
+    }
+
+    bitmap = f2fs_cp_bitmap(cp_area, cp_size, 1);
+    if (bitmap != NULL) {
+        sit_bitmap = malloc(bitmap_size);
+        if (sit_bitmap == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        memcpy(sit_bitmap, bitmap, bitmap_size);
+    }
+
+    free(cp_area);
+
+    return sit_bitmap;
+}
+
+/*
+ * Set the segment information and valid block bitmap of a main area segment
+ * from its SIT entry
+ *
+ * @segman: struct segment_manager * to set the segment in
+ * @segno: main area segment number
+ * @sit_entry: struct f2fs_sit_entry * of the segment
+ *
+ * */
+static void f2fs_set_segment_info(struct segment_manager *segman,
+                                  uint32_t segno,
+                                  struct f2fs_sit_entry *sit_entry) {
+    segman->segments[segno].id = segno;
+    segman->segments[segno].type = GET_SIT_TYPE(sit_entry);
+    segman->segments[segno].valid_blocks = GET_SIT_VBLOCKS(sit_entry);
+
+    if (segman->valid_maps) {
+        memcpy(&segman->valid_maps[(size_t)segno * SIT_VBLOCK_MAP_SIZE],
+               sit_entry->valid_map, SIT_VBLOCK_MAP_SIZE);
+    }
+}
+
+/*
+ * Read the segment information of all main area segments from the SIT.
+ * Like the NAT, each SIT block has two copies, of which the valid one is
+ * indicated by the SIT version bitmap of the active checkpoint. The first
+ * copies of all SIT blocks are in the first half of the SIT area, the second
+ * copies in the second half. Both halves are read in chunks of a segment, and
+ * the entries of the SIT journal are applied on top.
+ *
+ * @dev_path: device path where the SIT is on
+ * @segman: struct segment_manager * to fill, with space for all main area
+ * segments
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if the SIT could not be read
+ *
+ * */
+static int f2fs_read_sit(char *dev_path, struct segment_manager *segman) {
+    struct f2fs_dev *dev = NULL;
+    int ret = EXIT_FAILURE;
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t sit_blocks, copy_blocks, nr_blocks, segno, cp_addr;
+    uint16_t n_sits;
+    unsigned char *sit_bitmap = NULL, *sit_copies = NULL, *sum_block = NULL;
+    struct f2fs_checkpoint *cp_block = NULL;
+    struct f2fs_sit_block *sit_block = NULL;
+    struct f2fs_journal *journal = NULL;
+
+    sit_blocks = (f2fs_sb.segment_count_main + SIT_ENTRY_PER_BLOCK - 1) /
+                 SIT_ENTRY_PER_BLOCK;
+    /* segment_count_sit includes the segments of both copies */
+    copy_blocks = (f2fs_sb.segment_count_sit >> 1)
+                  << f2fs_sb.log_blocks_per_seg;
+
+    if (sit_blocks > copy_blocks) {
+        WARN("SIT with %u blocks is too small for %u main segments\n",
+             copy_blocks, f2fs_sb.segment_count_main);
+        return EXIT_FAILURE;
+    }
+
+    dev = f2fs_get_dev(dev_path);
+    if (dev == NULL) {
+        WARN("Failed opening device fd for %s\n", dev_path);
+        return EXIT_FAILURE;
+    }
+
+    cp_block = f2fs_read_active_cp(dev, &cp_addr);
+
+    sit_bitmap = f2fs_read_sit_bitmap(dev, cp_block, cp_addr);
+    if (sit_bitmap == NULL) {
+        WARN("Invalid SIT version bitmap in the checkpoint\n");
+        goto cleanup;
+    }
+
+    if ((uint64_t)cp_block->sit_ver_bitmap_bytesize * 8 < sit_blocks) {
+        WARN("SIT version bitmap is too small for %u SIT blocks\n",
+             sit_blocks);
+        goto cleanup;
+    }
 
-                free(split_string);
-                segman->segments[segman->nr_segments].id = segman->nr_segments;
-                segman->nr_segments++;
+    sit_copies = f2fs_alloc_io_buf((size_t)BLOCK_SZ * blocks_per_seg * 2);
+
+    for (uint32_t blk_off = 0; blk_off < sit_blocks; blk_off += nr_blocks) {
+        nr_blocks = sit_blocks - blk_off;
+        if (nr_blocks > blocks_per_seg) {
+            nr_blocks = blocks_per_seg;
+        }
+
+        if (!f2fs_read_block(
+                dev, sit_copies,
+                (uint64_t)(f2fs_sb.sit_blkaddr + blk_off) << F2FS_BLKSIZE_BITS,
+                (size_t)BLOCK_SZ * nr_blocks) ||
+            !f2fs_read_block(dev,
+                             sit_copies + (size_t)BLOCK_SZ * blocks_per_seg,
+                             (uint64_t)(f2fs_sb.sit_blkaddr + copy_blocks +
+                                        blk_off)
+                                 << F2FS_BLKSIZE_BITS,
+                             (size_t)BLOCK_SZ * nr_blocks)) {
+            WARN("Failed reading SIT block %#" PRIx32 " from %s\n",
+                 f2fs_sb.sit_blkaddr + blk_off, dev_path);
+            goto cleanup;
+        }
+
+        for (uint32_t blk = 0; blk < nr_blocks; blk++) {
+            sit_block = (struct f2fs_sit_block *)&sit_copies[(size_t)blk *
+                                                              BLOCK_SZ];
+            if (f2fs_test_bit(blk_off + blk, sit_bitmap)) {
+                sit_block = (struct f2fs_sit_block *)&sit_copies
+                    [(size_t)(blk + blocks_per_seg) * BLOCK_SZ];
+            }
+
+            for (uint32_t i = 0; i < SIT_ENTRY_PER_BLOCK; i++) {
+                segno = (blk_off + blk) * SIT_ENTRY_PER_BLOCK + i;
+                if (segno >= f2fs_sb.segment_count_main) {
+                    break;
+                }
+                f2fs_set_segment_info(segman, segno, &sit_block->entries[i]);
             }
         }
+    }
+
+    /* recently updated SIT entries are only in the SIT journal */
+    sum_block = calloc(1, BLOCK_SZ);
+    journal =
+        f2fs_read_journal(dev, cp_block, cp_addr, CURSEG_COLD_DATA, sum_block);
 
-        free(contents);
+    n_sits = journal->n_sits;
+    if (n_sits > SIT_JOURNAL_ENTRIES) {
+        n_sits = SIT_JOURNAL_ENTRIES;
+    }
 
-        /* only going to max allocated, as specified in the F2FS superblock */
-        if (segman->nr_segments > highest_segment) {
-            goto finish;
+    for (uint16_t i = 0; i < n_sits; i++) {
+        segno = journal->sit_j.entries[i].segno;
+        if (segno < f2fs_sb.segment_count_main) {
+            f2fs_set_segment_info(segman, segno, &journal->sit_j.entries[i].se);
         }
     }
 
-finish:
-    fclose(fp);
-    free(dev_string);
+    segman->nr_segments = f2fs_sb.segment_count_main;
+    ret = EXIT_SUCCESS;
 
-    return EXIT_SUCCESS;
+cleanup:
+    free(sum_block);
+    free(sit_copies);
+    free(sit_bitmap);
+
+    return ret;
 }
 
-extern void *f2fs_fs_manager_init(char *dev_name) {
+/*
+ * Initialize the segment manager with the type and valid block count of all
+ * main area segments. These are read from the SIT, or from procfs if
+ * use_procfs is set or the SIT cannot be read.
+ *
+ * @dev_path: device path where the F2FS metadata is on
+ * @zns_offset: byte offset at which the ZNS device starts in the F2FS
+ * address space
+ * @use_procfs: read /proc/fs/f2fs/<dev>/segment_info instead of the SIT
+ *
+ * returns: void * to the struct segment_manager, NULL on failure
+ *
+ * */
+extern void *f2fs_fs_manager_init(char *dev_path, uint64_t zns_offset,
+                                  uint8_t use_procfs) {
     struct segment_manager *segman;
+    uint64_t zns_blkaddr = zns_offset >> F2FS_BLKSIZE_BITS;
 
     segman =
         calloc(1, sizeof(struct segment_manager) +
                       sizeof(struct segment_info) * f2fs_sb.segment_count_main);
+    if (segman == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    /* segments are numbered from the start of the main area, which can begin
+     * on the conventional device before the ZNS device */
+    if (zns_blkaddr > f2fs_sb.main_blkaddr) {
+        segman->zns_segno_offset = (zns_blkaddr - f2fs_sb.main_blkaddr) >>
+                                   f2fs_sb.log_blocks_per_seg;
+    }
 
-    if (init_procfs_segment_bits(dev_name, f2fs_sb.segment_count_main,
+    /* the open logs as of the active checkpoint */
+    f2fs_read_checkpoint(dev_path);
+    for (uint8_t i = 0; i < NR_CURSEG_DATA_TYPE; i++) {
+        segman->cursegs[CURSEG_HOT_DATA + i].segno = f2fs_cp.cur_data_segno[i];
+        segman->cursegs[CURSEG_HOT_DATA + i].blkoff =
+            f2fs_cp.cur_data_blkoff[i];
+        segman->cursegs[CURSEG_HOT_DATA + i].alloc_type =
+            f2fs_cp.alloc_type[CURSEG_HOT_DATA + i];
+    }
+    for (uint8_t i = 0; i < NR_CURSEG_NODE_TYPE; i++) {
+        segman->cursegs[CURSEG_HOT_NODE + i].segno = f2fs_cp.cur_node_segno[i];
+        segman->cursegs[CURSEG_HOT_NODE + i].blkoff =
+            f2fs_cp.cur_node_blkoff[i];
+        segman->cursegs[CURSEG_HOT_NODE + i].alloc_type =
+            f2fs_cp.alloc_type[CURSEG_HOT_NODE + i];
+    }
+
+    /* a compact store of the valid block bitmaps of all segments, without
+     * it segments only have their valid block count */
+    segman->valid_maps =
+        calloc(f2fs_sb.segment_count_main, SIT_VBLOCK_MAP_SIZE);
+    if (segman->valid_maps == NULL) {
+        WARN("Failed allocating valid block bitmaps, not showing segment "
+             "fragmentation\n");
+    }
+
+    if (!use_procfs) {
+        if (f2fs_read_sit(dev_path, segman) == EXIT_SUCCESS) {
+            return segman;
+        }
+
+        WARN("Failed reading the SIT from %s, falling back to procfs.\n",
+             dev_path);
+        segman->nr_segments = 0;
+    }
+
+    if (init_procfs_segment_bits(dev_path, f2fs_sb.segment_count_main,
                                  segman) == EXIT_FAILURE) {
         goto cleanup;
     }
 
+    if (segman->valid_maps) {
+        memset(segman->valid_maps, 0,
+               (size_t)f2fs_sb.segment_count_main * SIT_VBLOCK_MAP_SIZE);
+
+        if (init_procfs_valid_maps(dev_path, segman) == EXIT_FAILURE) {
+            WARN("Failed reading segment_bits from procfs, not showing "
+                 "segment fragmentation\n");
+            free(segman->valid_maps);
+            segman->valid_maps = NULL;
+        }
+    }
+
     return segman;
 
 cleanup:
+    free(segman->valid_maps);
     free(segman);
 
     return NULL;
@@ -541,6 +1716,7 @@ static void f2fs_fs_manager_clean(void *fs_info) {
 
     segman = (struct segment_manager *)fs_info;
 
+    free(segman->valid_maps);
     free(segman);
 
 finish:
@@ -551,6 +1727,153 @@ extern fs_manager_cleanup f2fs_fs_manager_cleanup() {
     return &f2fs_fs_manager_clean;
 }
 
+/*
+ * Get the fragmentation of the valid blocks in a segment, as the number of
+ * additional runs of valid blocks relative to the worst case where each valid
+ * block is its own run.
+ *
+ * @valid_map: valid block bitmap of the segment
+ * @valid_blocks: number of valid blocks in the segment
+ *
+ * returns: fragmentation in percent, 0 if the valid blocks are contiguous
+ *
+ * */
+static uint32_t f2fs_segment_frag(const unsigned char *valid_map,
+                                  uint32_t valid_blocks) {
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t runs = 0;
+    int prev = 0, cur;
+
+    if (valid_blocks < 2) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < blocks_per_seg; i++) {
+        cur = f2fs_test_bit(i, valid_map) != 0;
+        if (cur && !prev) {
+            runs++;
+        }
+        prev = cur;
+    }
+
+    if (runs < 2) {
+        return 0;
+    }
+
+    return (runs - 1) * 100 / (valid_blocks - 1);
+}
+
+/*
+ * Estimate the cost of garbage collecting a range of written blocks, such as
+ * a zone, from the valid block counts of its segments. Blocks that are
+ * written but no longer valid are reclaimed by GC, valid blocks have to be
+ * migrated.
+ *
+ * @fs_manager: void * to the struct segment_manager
+ * @segment: first segment of the range, relative to the start of the ZNS
+ * device
+ * @written_blocks: number of written F2FS blocks in the range
+ * @gc: struct f2fs_gc_estimate * to set
+ *
+ * returns: 1 if the estimate is set, 0 if there is no segment information
+ *
+ * */
+extern uint8_t f2fs_estimate_gc(void *fs_manager, uint32_t segment,
+                                uint64_t written_blocks,
+                                struct f2fs_gc_estimate *gc) {
+    struct segment_manager *segman = (struct segment_manager *)fs_manager;
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t seg_written, valid_blocks;
+
+    memset(gc, 0, sizeof(struct f2fs_gc_estimate));
+
+    if (segman == NULL) {
+        return 0;
+    }
+
+    segment += segman->zns_segno_offset;
+    while (written_blocks > 0 && segment < segman->nr_segments) {
+        seg_written =
+            written_blocks < blocks_per_seg ? written_blocks : blocks_per_seg;
+        valid_blocks = segman->segments[segment].valid_blocks;
+        if (valid_blocks > seg_written) {
+            valid_blocks = seg_written;
+        }
+
+        gc->nr_segments++;
+        gc->valid_blocks += valid_blocks;
+        gc->dead_blocks += seg_written - valid_blocks;
+
+        written_blocks -= seg_written;
+        segment++;
+    }
+
+    return 1;
+}
+
+/*
+ * Get a current segment (open log) of the active checkpoint.
+ *
+ * @fs_manager: void * to the struct segment_manager
+ * @type: enum type of the log
+ * @segment: set to the segment of the log, relative to the start of the ZNS
+ * device
+ * @blkoff: set to the next block to allocate in the segment
+ * @alloc_type: set to the allocation type of the log, LFS or SSR
+ *
+ * returns: 1 if the log is set and on the ZNS device, else 0
+ *
+ * */
+extern uint8_t f2fs_get_curseg(void *fs_manager, enum type type,
+                               uint32_t *segment, uint32_t *blkoff,
+                               uint8_t *alloc_type) {
+    struct segment_manager *segman = (struct segment_manager *)fs_manager;
+    struct f2fs_curseg *curseg;
+
+    if (segman == NULL || type >= NR_CURSEG_TYPE) {
+        return 0;
+    }
+
+    curseg = &segman->cursegs[type];
+    if (curseg->segno < segman->zns_segno_offset ||
+        curseg->segno >= f2fs_sb.segment_count_main) {
+        return 0;
+    }
+
+    *segment = curseg->segno - segman->zns_segno_offset;
+    *blkoff = curseg->blkoff;
+    *alloc_type = curseg->alloc_type;
+
+    return 1;
+}
+
+/*
+ * Get the name of a segment type
+ *
+ * @type: enum type of the segment
+ *
+ * returns: const char * to the name, "UNKNOWN" for NO_CHECK_TYPE
+ *
+ * */
+extern const char *f2fs_type_name(enum type type) {
+    switch (type) {
+    case CURSEG_HOT_DATA:
+        return "CURSEG_HOT_DATA";
+    case CURSEG_WARM_DATA:
+        return "CURSEG_WARM_DATA";
+    case CURSEG_COLD_DATA:
+        return "CURSEG_COLD_DATA";
+    case CURSEG_HOT_NODE:
+        return "CURSEG_HOT_NODE";
+    case CURSEG_WARM_NODE:
+        return "CURSEG_WARM_NODE";
+    case CURSEG_COLD_NODE:
+        return "CURSEG_COLD_NODE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
 extern uint32_t get_fs_info_bytes() { return sizeof(struct segment_info); }
 
 static void fs_info_initialize(void *fs_manager, void *fs_info,
@@ -561,9 +1884,35 @@ static void fs_info_initialize(void *fs_manager, void *fs_info,
     segman = (struct segment_manager *)fs_manager;
     seg_i = (struct segment_info *)fs_info;
 
+    /* segment is relative to the start of the ZNS device */
+    if (segman == NULL ||
+        segment + segman->zns_segno_offset >= segman->nr_segments) {
+        seg_i->id = segment;
+        seg_i->type = NO_CHECK_TYPE;
+        seg_i->valid_blocks = 0;
+        seg_i->frag = SEGMENT_FRAG_UNKNOWN;
+        seg_i->log_blkoff = CURSEG_NOT_OPEN;
+        return;
+    }
+
+    segment += segman->zns_segno_offset;
     seg_i->id = segman->segments[segment].id;
     seg_i->type = segman->segments[segment].type;
     seg_i->valid_blocks = segman->segments[segment].valid_blocks;
+    seg_i->frag = SEGMENT_FRAG_UNKNOWN;
+    seg_i->log_blkoff = CURSEG_NOT_OPEN;
+
+    for (uint8_t i = 0; i < NR_CURSEG_TYPE; i++) {
+        if (segman->cursegs[i].segno == segment) {
+            seg_i->log_blkoff = segman->cursegs[i].blkoff;
+        }
+    }
+
+    if (segman->valid_maps) {
+        seg_i->frag = f2fs_segment_frag(
+            &segman->valid_maps[(size_t)segment * SIT_VBLOCK_MAP_SIZE],
+            seg_i->valid_blocks);
+    }
 }
 
 extern fs_info_init f2fs_fs_info_init() { return &fs_info_initialize; }
@@ -572,23 +1921,31 @@ static void f2fs_show_segment(void *fs_info, uint8_t show_only_stats,
                               unsigned int sector_shift) {
     struct segment_info *seg_i = (struct segment_info *)fs_info;
 
-    REP(show_only_stats, "+++++ TYPE: ");
-    if (seg_i->type == CURSEG_HOT_DATA) {
-        REP(show_only_stats, "CURSEG_HOT_DATA");
-    } else if (seg_i->type == CURSEG_WARM_DATA) {
-        REP(show_only_stats, "CURSEG_WARM_DATA");
-    } else if (seg_i->type == CURSEG_COLD_DATA) {
-        REP(show_only_stats, "CURSEG_COLD_DATA");
-    } else if (seg_i->type == CURSEG_HOT_NODE) {
-        REP(show_only_stats, "CURSEG_HOT_NODE");
-    } else if (seg_i->type == CURSEG_WARM_NODE) {
-        REP(show_only_stats, "CURSEG_WARM_NODE");
-    } else if (seg_i->type == CURSEG_COLD_NODE) {
-        REP(show_only_stats, "CURSEG_COLD_NODE");
-    }
-
-    REP(show_only_stats, "  VALID BLOCKS: %3u\n",
-        seg_i->valid_blocks << F2FS_BLKSIZE_BITS >> sector_shift);
+    REP(show_only_stats, "+++++ TYPE: %s", f2fs_type_name(seg_i->type));
+    if (seg_i->type >= NO_CHECK_TYPE) {
+        REP(show_only_stats, "\n");
+        return;
+    }
+
+    /* blocks of the segment that are not valid are dead, or not yet written
+     * if the segment is still being written */
+    REP(show_only_stats, "  VALID BLOCKS: %3u  DEAD BLOCKS: %3u",
+        seg_i->valid_blocks << F2FS_BLKSIZE_BITS >> sector_shift,
+        ((1 << f2fs_sb.log_blocks_per_seg) - seg_i->valid_blocks)
+            << F2FS_BLKSIZE_BITS >> sector_shift);
+
+    if (seg_i->frag == SEGMENT_FRAG_UNKNOWN) {
+        REP(show_only_stats, "  FRAG:   -");
+    } else {
+        REP(show_only_stats, "  FRAG: %3u%%", seg_i->frag);
+    }
+
+    /* the log head is as of the last checkpoint */
+    if (seg_i->log_blkoff != CURSEG_NOT_OPEN) {
+        REP(show_only_stats, "  OPEN LOG OFFSET: %#x",
+            seg_i->log_blkoff << F2FS_BLKSIZE_BITS >> sector_shift);
+    }
+    REP(show_only_stats, "\n");
     // TODO: REMOVE RANGE SEGMENTS, just show each segment, should simplify
     // segmap while loop as well
     /* if (is_range) { */
@@ -600,15 +1957,14 @@ static void f2fs_show_segment(void *fs_info, uint8_t show_only_stats,
 
 extern fs_info_show f2fs_fs_info_show() { return &f2fs_show_segment; }
 
-static void fs_info_clean(void *fs_info) {
-    if (fs_info == NULL) {
-        goto finish;
-    }
-
-    free(fs_info);
-
-finish:
-    return;
-}
+/*
+ * Cleanup of the segment information of an extent. The segment information is
+ * stored in the slab slot of its extent and is released with the extent slabs
+ * by cleanup_zonemap(), hence nothing is freed here.
+ *
+ * @fs_info: void * to the struct segment_info of an extent
+ *
+ * */
+static void fs_info_clean(void *fs_info) { (void)fs_info; }
 
 extern fs_info_cleanup f2fs_fs_info_cleanup() { return &fs_info_clean; }
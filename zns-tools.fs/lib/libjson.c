@@ -3,421 +3,387 @@
 #include <string.h>
 #include <time.h>
 
-static char *uint64_to_hex_string_cast(uint64_t value) {
-    char *buf = calloc(1, sizeof(uint64_t) + 8);
-
-    snprintf(buf, sizeof(uint64_t) + 7, "0x%" PRIx64 "", value);
-
-    return buf;
-}
-
-static char *uint32_to_hex_string_cast(uint32_t value) {
-    char *buf = calloc(1, sizeof(uint32_t) + 8);
-
-    snprintf(buf, sizeof(uint32_t) + 7, "0x%" PRIx32 "", value);
+/* state of the zonemap dump, tracking the open zone and segment objects */
+struct json_dump_state {
+    uint8_t zone_open;    /* if a zone object is open */
+    uint8_t segment_open; /* if a segment object is open */
+    uint64_t segment_id;  /* id of the open segment */
+};
+
+static struct json_writer json_out;
+static struct json_dump_state json_state;
+
+/*
+ * Open the output file of a json writer, buffering writes in a user-space
+ * buffer of JSON_WRITE_BUF_SZ bytes.
+ *
+ * @w: struct json_writer * to initialize
+ * @file: path of the output file
+ *
+ * */
+void json_writer_open(struct json_writer *w, char *file) {
+    memset(w, 0, sizeof(struct json_writer));
+
+    w->fp = fopen(file, "w");
+    if (!w->fp) {
+        ERR_MSG("Failed opening json output file %s\n", file);
+    }
 
-    return buf;
+    w->buf = malloc(JSON_WRITE_BUF_SZ);
+    if (!w->buf) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    setvbuf(w->fp, w->buf, _IOFBF, JSON_WRITE_BUF_SZ);
 }
 
-static char *uint32_to_string_cast(uint32_t value) {
-    char *buf = calloc(1, sizeof(uint32_t) + 1);
-
-    snprintf(buf, sizeof(uint32_t), "%d", value);
+/*
+ * Flush and close the output file of a json writer.
+ *
+ * @w: struct json_writer * to close
+ * @file: path of the output file, for error reporting
+ *
+ * */
+void json_writer_close(struct json_writer *w, char *file) {
+    int err;
+
+    fputc('\n', w->fp);
+
+    err = ferror(w->fp);
+    if (fclose(w->fp) || err) {
+        ERR_MSG("Failed saving json data to %s\n", file);
+    }
 
-    return buf;
+    free(w->buf);
+    w->fp = NULL;
+    w->buf = NULL;
 }
 
-static json_object *json_get_bdev(struct bdev bdev) {
-    char *value;
-    json_object *dev = json_object_new_object();
-
-    json_object_object_add(dev, "dev_name",
-                           json_object_new_string(bdev.dev_name));
-    json_object_object_add(dev, "dev_path",
-                           json_object_new_string(bdev.dev_path));
-    json_object_object_add(dev, "link_name",
-                           json_object_new_string(bdev.link_name));
-    json_object_object_add(dev, "is_zoned",
-                           json_object_new_boolean(bdev.is_zoned));
-
-    if (bdev.is_zoned) {
-        json_object_object_add(dev, "nr_zones",
-                               json_object_new_int(bdev.nr_zones));
-        json_object_object_add(dev, "zone_size",
-                               json_object_new_int(bdev.zone_size));
-
-        value = uint32_to_hex_string_cast(bdev.zone_mask);
-        json_object_object_add(dev, "zone_mask", json_object_new_string(value));
-        free(value);
-
-        json_object_object_add(dev, "sector_size",
-                               json_object_new_int(ctrl.sector_size));
-        json_object_object_add(dev, "sector_shift",
-                               json_object_new_int(ctrl.sector_shift));
+static void json_write_string(struct json_writer *w, const char *str) {
+    const unsigned char *c = (const unsigned char *)str;
+
+    fputc('"', w->fp);
+    for (; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', w->fp);
+            fputc(*c, w->fp);
+        } else if (*c < 0x20) {
+            fprintf(w->fp, "\\u%04x", *c);
+        } else {
+            fputc(*c, w->fp);
+        }
     }
-
-    return dev;
+    fputc('"', w->fp);
 }
 
-static json_object *json_get_fs_info() {
-    char *value;
-    json_object *fs = json_object_new_object();
-
-    value = uint64_to_hex_string_cast(ctrl.fs_magic);
-    json_object_object_add(fs, "fs_magic", json_object_new_string(value));
-    free(value);
-
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        json_object_object_add(fs, "fs", json_object_new_string("F2FS"));
-        json_object_object_add(
-            fs, "f2fs_segment_sectors",
-            json_object_new_double(ctrl.f2fs_segment_sectors));
-        json_object_object_add(fs, "f2fs_segment_shift",
-                               json_object_new_int(ctrl.segment_shift));
-
-        value = uint64_to_hex_string_cast(ctrl.f2fs_segment_mask);
-        json_object_object_add(fs, "f2fs_segment_mask",
-                               json_object_new_string(value));
-        free(value);
-    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
-        json_object_object_add(fs, "fs", json_object_new_string("Btrfs"));
+/* write the separator and key of the next member at the current level, key is
+ * NULL for array elements */
+static void json_write_key(struct json_writer *w, const char *key) {
+    if (w->has_items[w->depth]) {
+        fputc(',', w->fp);
     }
+    w->has_items[w->depth] = 1;
 
-    return fs;
+    if (key) {
+        json_write_string(w, key);
+        fputc(':', w->fp);
+    }
 }
 
-static json_object *json_get_ctrl_config() {
-    json_object *config, *dev, *fs;
-
-    config = json_object_new_object();
-
-    if (ctrl.multi_dev) {
-        dev = json_get_bdev(ctrl.bdev);
-        json_object_object_add(config, "dev-1", dev);
+static void json_begin(struct json_writer *w, const char *key, char open) {
+    if (w->depth + 1 >= JSON_MAX_DEPTH) {
+        ERR_MSG("Exceeded json nesting depth of %d\n", JSON_MAX_DEPTH);
     }
 
-    dev = json_get_bdev(ctrl.znsdev);
-    json_object_object_add(config, "dev-2", dev);
-
-    fs = json_get_fs_info();
-    json_object_object_add(config, "filesystem", fs);
-
-    return config;
+    json_write_key(w, key);
+    fputc(open, w->fp);
+    w->depth++;
+    w->has_items[w->depth] = 0;
 }
 
-static int init_json_file() {
-    json_object *info;
-    struct timespec ts;
-
-    ctrl.json_root = json_object_new_object();
+static void json_end(struct json_writer *w, char close) {
+    fputc(close, w->fp);
+    w->depth--;
+}
 
-    if (!ctrl.json_root)
-        ERR_MSG("Failed setting json output root object\n");
+void json_begin_object(struct json_writer *w, const char *key) {
+    json_begin(w, key, '{');
+}
 
-    info = json_object_new_object();
+void json_begin_object_nr(struct json_writer *w, uint64_t key) {
+    char value[21];
 
-    json_object_object_add(info, "program", json_object_new_string(ctrl.argv));
+    snprintf(value, sizeof(value), "%" PRIu64, key);
+    json_begin(w, value, '{');
+}
 
-    // TODO: What time do we need? realtime format with day...?
-    clock_gettime(CLOCK_REALTIME, &ts);
+void json_end_object(struct json_writer *w) { json_end(w, '}'); }
 
-    json_object_object_add(info, "time", json_object_new_uint64(ts.tv_sec));
-    json_object_object_add(info, "config", json_get_ctrl_config());
+void json_begin_array(struct json_writer *w, const char *key) {
+    json_begin(w, key, '[');
+}
 
-    json_object_object_add(ctrl.json_root, "info", info);
+void json_end_array(struct json_writer *w) { json_end(w, ']'); }
 
-    return EXIT_SUCCESS;
+void json_add_string(struct json_writer *w, const char *key,
+                     const char *value) {
+    json_write_key(w, key);
+    json_write_string(w, value);
 }
 
-static json_object *json_get_zone_info(uint32_t zone) {
-    json_object *zone_json = json_object_new_object();
-    char *value;
-    unsigned long long start_sector = 0;
-    struct blk_zone_report *hdr = NULL;
-
-    start_sector = (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * zone;
+void json_add_hex(struct json_writer *w, const char *key, uint64_t value) {
+    json_write_key(w, key);
+    fprintf(w->fp, "\"0x%" PRIx64 "\"", value);
+}
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
-    if (fd < 0) {
-        return NULL;
-    }
+void json_add_uint(struct json_writer *w, const char *key, uint64_t value) {
+    json_write_key(w, key);
+    fprintf(w->fp, "%" PRIu64, value);
+}
 
-    hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
-    hdr->nr_zones = 1;
+void json_add_bool(struct json_writer *w, const char *key, uint8_t value) {
+    json_write_key(w, key);
+    fputs(value ? "true" : "false", w->fp);
+}
 
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return NULL;
+static void json_add_bdev(struct json_writer *w, const char *key,
+                          struct bdev *bdev) {
+    json_begin_object(w, key);
+    json_add_string(w, "dev_name", bdev->dev_name);
+    json_add_string(w, "dev_path", bdev->dev_path);
+    json_add_string(w, "link_name", bdev->link_name);
+    json_add_bool(w, "is_zoned", bdev->is_zoned);
+
+    if (bdev->is_zoned) {
+        json_add_uint(w, "nr_zones", bdev->nr_zones);
+        json_add_uint(w, "zone_size", bdev->zone_size);
+        json_add_hex(w, "zone_mask", bdev->zone_mask);
+        json_add_uint(w, "sector_size", ctrl.sector_size);
+        json_add_uint(w, "sector_shift", ctrl.sector_shift);
     }
 
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].start >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "lbas", json_object_new_string(value));
-    free(value);
+    json_end_object(w);
+}
 
-    value = uint64_to_hex_string_cast(
-        (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-        (hdr->zones[0].capacity >> ctrl.zns_sector_shift));
-    json_object_object_add(zone_json, "lbae", json_object_new_string(value));
-    free(value);
+static void json_add_fs_info(struct json_writer *w) {
+    json_begin_object(w, "filesystem");
+    json_add_hex(w, "fs_magic", ctrl.fs_magic);
 
-    value = uint64_to_hex_string_cast(hdr->zones[0].capacity >>
-                                      ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "cap", json_object_new_string(value));
-    free(value);
+    if (ctrl.fs_magic == F2FS_MAGIC) {
+        json_add_string(w, "fs", "F2FS");
+        json_add_uint(w, "f2fs_segment_sectors", ctrl.f2fs_segment_sectors);
+        json_add_uint(w, "f2fs_segment_shift", ctrl.segment_shift);
+        json_add_hex(w, "f2fs_segment_mask", ctrl.f2fs_segment_mask);
+    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
+        json_add_string(w, "fs", "Btrfs");
+    }
 
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].wp >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "wp", json_object_new_string(value));
-    free(value);
+    json_end_object(w);
+}
 
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].len >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "size", json_object_new_string(value));
-    free(value);
+static void json_add_info(struct json_writer *w) {
+    struct timespec ts;
 
-    value = uint32_to_hex_string_cast(hdr->zones[0].cond << 4);
-    json_object_object_add(zone_json, "state", json_object_new_string(value));
-    free(value);
+    json_begin_object(w, "info");
+    json_add_string(w, "program", ctrl.argv);
 
-    value = uint32_to_hex_string_cast(ctrl.znsdev.zone_mask);
-    json_object_object_add(zone_json, "mask", json_object_new_string(value));
-    free(value);
+    // TODO: What time do we need? realtime format with day...?
+    if (ctrl.json_time) {
+        json_add_uint(w, "time", ctrl.json_time);
+    } else {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        json_add_uint(w, "time", ts.tv_sec);
+    }
 
-    close(fd);
+    json_begin_object(w, "config");
+    if (ctrl.multi_dev) {
+        json_add_bdev(w, "dev-1", &ctrl.bdev);
+    }
+    json_add_bdev(w, "dev-2", &ctrl.znsdev);
+    json_add_fs_info(w);
+    json_end_object(w);
 
-    free(hdr);
-    hdr = NULL;
+    json_end_object(w);
+}
 
-    return zone_json;
+static void json_add_zone_info(struct json_writer *w, uint32_t zone) {
+    struct zone *z = &ctrl.zonemap->zones[zone];
+
+    json_begin_object(w, "zone_info");
+    json_add_hex(w, "lbas", z->start);
+    json_add_hex(w, "lbae", z->end);
+    json_add_hex(w, "cap", z->capacity);
+    json_add_hex(w, "wp", z->wp);
+    json_add_hex(w, "size", z->size);
+    json_add_hex(w, "state", z->state);
+    json_add_hex(w, "mask", ctrl.znsdev.zone_mask);
+    json_end_object(w);
 }
 
-static json_object *json_get_segment_info(struct extent *extent,
-                                          uint64_t segment_start) {
-    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
-    char *value;
-    json_object *segment = json_object_new_object();
-
-    value = uint64_to_hex_string_cast(segment_start << ctrl.segment_shift);
-    json_object_object_add(segment, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast((segment_start << ctrl.segment_shift) +
-                                      ctrl.f2fs_segment_sectors);
-    json_object_object_add(segment, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(ctrl.f2fs_segment_sectors);
-    json_object_object_add(segment, "size", json_object_new_string(value));
-    free(value);
-
-    switch (seg_i->type) {
-    case CURSEG_HOT_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_HOT_DATA"));
-        break;
-    case CURSEG_WARM_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_WARM_DATA"));
-        break;
-    case CURSEG_COLD_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_COLD_DATA"));
-        break;
-    case CURSEG_HOT_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_HOT_NODE"));
-        break;
-    case CURSEG_WARM_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_WARM_NODE"));
-        break;
-    case CURSEG_COLD_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_COLD_NODE"));
-        break;
-    case NO_CHECK_TYPE:
-        break;
+static void json_add_segment_info(struct json_writer *w,
+                                  struct segment_info *seg_i,
+                                  uint64_t segment_id) {
+    json_begin_object(w, "seg_info");
+    json_add_hex(w, "pbas", segment_id << ctrl.segment_shift);
+    json_add_hex(w, "pbae", (segment_id << ctrl.segment_shift) +
+                                ctrl.f2fs_segment_sectors);
+    json_add_hex(w, "size", ctrl.f2fs_segment_sectors);
+    if (seg_i->type != NO_CHECK_TYPE) {
+        json_add_string(w, "type", f2fs_type_name(seg_i->type));
     }
-
-    json_object_object_add(
-        segment, "valid_blocks",
-        json_object_new_int(seg_i->valid_blocks << F2FS_BLKSIZE_BITS >>
-                            ctrl.sector_shift));
-
-    return segment;
+    json_add_uint(w, "valid_blocks",
+                  seg_i->valid_blocks << F2FS_BLKSIZE_BITS >>
+                      ctrl.sector_shift);
+    json_end_object(w);
 }
 
-static json_object *json_get_extent_info(struct extent *extent) {
-    char *value;
-    json_object *ext = json_object_new_object();
-
-    json_object_object_add(ext, "file", json_object_new_string(extent->file));
-
-    value = uint64_to_hex_string_cast(extent->phy_blk);
-    json_object_object_add(ext, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(extent->phy_blk + extent->len);
-    json_object_object_add(ext, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(extent->len);
-    json_object_object_add(ext, "size", json_object_new_string(value));
-    free(value);
-
-    json_object_object_add(ext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        ext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
+static void json_close_segment() {
+    if (!json_state.segment_open) {
+        return;
+    }
 
-    return ext;
+    json_end_array(&json_out);
+    json_end_object(&json_out);
+    json_state.segment_open = 0;
 }
 
-static json_object *
-json_get_beginning_segment_extent_info(struct extent *extent) {
-    char *value;
-    json_object *ext = json_object_new_object();
-    uint64_t segment_start = (extent->phy_blk & ctrl.f2fs_segment_mask);
-    uint64_t segment_end = segment_start + (ctrl.f2fs_segment_sectors);
+/*
+ * Make the segment the open segment object of the zone, which the extents of
+ * the segment are written to. Closes the previously open segment.
+ *
+ * @extent: struct extent * that starts in or spans the segment
+ * @segment_id: id of the segment
+ *
+ * */
+static void json_open_segment(struct extent *extent, uint64_t segment_id) {
+    struct segment_info seg_i;
+    struct segment_info *info = (struct segment_info *)extent->fs_info;
+
+    if (json_state.segment_open && json_state.segment_id == segment_id) {
+        return;
+    }
 
-    json_object_object_add(ext, "file", json_object_new_string(extent->file));
+    json_close_segment();
 
-    value = uint64_to_hex_string_cast(extent->phy_blk);
-    json_object_object_add(ext, "pbas", json_object_new_string(value));
-    free(value);
+    /* fs_info of the extent is of the segment the extent starts in */
+    if (segment_id != ((extent->phy_blk & ctrl.f2fs_segment_mask) >>
+                       ctrl.segment_shift)) {
+        ctrl.fs_info_init(ctrl.fs_manager, &seg_i, segment_id);
+        info = &seg_i;
+    }
 
-    value = uint64_to_hex_string_cast(segment_end);
-    json_object_object_add(ext, "pbae", json_object_new_string(value));
-    free(value);
+    json_begin_object_nr(&json_out, segment_id);
+    json_add_segment_info(&json_out, info, segment_id);
+    json_begin_array(&json_out, "extents");
 
-    value = uint64_to_hex_string_cast(segment_end - extent->phy_blk);
-    json_object_object_add(ext, "size", json_object_new_string(value));
-    free(value);
+    json_state.segment_open = 1;
+    json_state.segment_id = segment_id;
+}
 
-    json_object_object_add(ext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        ext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
+static void json_open_zone(uint32_t zone) {
+    json_begin_object_nr(&json_out, zone);
+    json_add_zone_info(&json_out, zone);
+    json_begin_object(&json_out, "segments");
 
-    return ext;
+    json_state.zone_open = 1;
 }
 
-/* function is only for an extent that occupies the entire segment (up to the
- * last LBA) */
-static void json_add_single_segment_extent_info(struct extent *extent,
-                                                uint64_t segment_start,
-                                                json_object *root) {
-    char *value;
-    json_object *curseg, *curseg_extents, *curext;
+static void json_close_zone() {
+    if (!json_state.zone_open) {
+        return;
+    }
 
-    curseg = json_object_new_object();
-    json_object_object_add(curseg, "seg_info",
-                           json_get_segment_info(extent, segment_start));
-    curseg_extents = json_object_new_array();
+    json_close_segment();
+    json_end_object(&json_out);
+    json_end_object(&json_out);
+    json_state.zone_open = 0;
+}
 
-    curext = json_object_new_object();
+/*
+ * Write the part of an extent that is in the open segment.
+ *
+ * @extent: struct extent * to write
+ * @pbas: starting sector of the extent part
+ * @pbae: ending sector of the extent part
+ *
+ * */
+static void json_add_extent(struct extent *extent, uint64_t pbas,
+                            uint64_t pbae) {
+    json_begin_object(&json_out, NULL);
+    json_begin_object(&json_out, "ext_info");
+    json_add_string(&json_out, "file", get_file_name(extent->fileID));
+    json_add_hex(&json_out, "pbas", pbas);
+    json_add_hex(&json_out, "pbae", pbae);
+    json_add_hex(&json_out, "size", pbae - pbas);
+    json_add_uint(&json_out, "ext_nr", extent->ext_nr + 1);
+    json_add_uint(&json_out, "total_exts",
+                  get_file_extent_count(extent->fileID));
+    json_end_object(&json_out);
+    json_end_object(&json_out);
+}
 
-    json_object_object_add(curext, "ext_info", json_get_extent_info(extent));
-    json_object_array_add(curseg_extents, curext);
-    json_object_object_add(curseg, "extents", curseg_extents);
+/*
+ * Write an extent to the segments it occupies, splitting it at segment
+ * boundaries.
+ *
+ * @extent: struct extent * to write
+ *
+ * */
+static void json_add_segment_extents(struct extent *extent) {
+    uint64_t extent_end = extent->phy_blk + extent->len;
+    uint64_t segment_start = extent->phy_blk & ctrl.f2fs_segment_mask;
+    uint64_t segment_end = extent_end & ctrl.f2fs_segment_mask;
+    uint64_t segment_id = segment_start >> ctrl.segment_shift;
+
+    /* the extent begins and ends in the same segment */
+    if (segment_start == segment_end ||
+        extent_end == segment_start + ctrl.f2fs_segment_sectors) {
+        json_open_segment(extent, segment_id);
+        json_add_extent(extent, extent->phy_blk, extent_end);
+        return;
+    }
 
-    value = uint32_to_string_cast(segment_start);
-    json_object_object_add(root, value, curseg);
-    free(value);
-}
+    /* part 1: the beginning of extent to end of its first segment */
+    if (extent->phy_blk != segment_start) {
+        json_open_segment(extent, segment_id);
+        json_add_extent(extent, extent->phy_blk,
+                        segment_start + ctrl.f2fs_segment_sectors);
+        segment_id++;
+    }
 
-static void json_add_consecutive_segments_extent_info(struct extent *extent,
-                                                      uint64_t segment_start,
-                                                      json_object *root) {
-    uint64_t segment_end =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t num_segments = segment_end - segment_start;
-
-    if (num_segments == 1) {
-        /* The extent starts exactly at the segment beginning and ends somewhere
-         * in the next segment then we just want to show the 1st segment */
-        json_add_single_segment_extent_info(extent, segment_start, root);
-    } else {
-        for (uint32_t cur = segment_start; cur < segment_end - 1;
-             cur += ctrl.f2fs_segment_sectors) {
-            json_add_single_segment_extent_info(extent, segment_start, root);
-        }
+    /* part 2: all segments that are entirely occupied by the extent */
+    for (; (segment_id << ctrl.segment_shift) < segment_end; segment_id++) {
+        json_open_segment(extent, segment_id);
+        json_add_extent(extent, segment_id << ctrl.segment_shift,
+                        (segment_id << ctrl.segment_shift) +
+                            ctrl.f2fs_segment_sectors);
     }
-}
 
-static void json_add_remainder_segment_extent_info(struct extent *extent,
-                                                   json_object *root) {
-    uint64_t segment_start =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t remainder =
-        extent->phy_blk + extent->len - (segment_start << ctrl.segment_shift);
-    char *value;
-    json_object *curext;
-
-    curext = json_object_new_object();
-
-    json_object_object_add(curext, "file",
-                           json_object_new_string(extent->file));
-
-    value = uint64_to_hex_string_cast(segment_start << ctrl.segment_shift);
-    json_object_object_add(curext, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast((segment_start << ctrl.segment_shift) +
-                                      remainder);
-    json_object_object_add(curext, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(remainder);
-    json_object_object_add(curext, "size", json_object_new_string(value));
-    free(value);
-
-    json_object_object_add(curext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        curext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
-
-    json_object_array_add(root, curext);
+    /* part 3: the remainder of the extent in its last segment */
+    if (segment_end != extent_end) {
+        json_open_segment(extent, segment_end >> ctrl.segment_shift);
+        json_add_extent(extent, segment_end, extent_end);
+    }
 }
 
 /* F2FS specific report of file mappings similarly results in a different
- * json data for the segment info, which is dumped by this function */
+ * json data for the segment info, which is written by this function. Zones and
+ * segments are written as the zone map is walked, such that memory use does not
+ * depend on the number of extents. */
 static int json_dump_f2fs_zonemap() {
-    struct node *current;
-    uint32_t i = 0, extents = 0;
-    uint32_t current_zone = 0;
+    struct extent *current;
     uint64_t segment_id = 0;
     uint64_t start_lba =
         ctrl.start_zone * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
     uint64_t end_lba =
         (ctrl.end_zone + 1) * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
-    json_object *zonemap = json_object_new_object();
-    json_object *zone, *zone_segments,
-        *curseg = json_object_new_object(),
-        *curseg_extents = json_object_new_array(), *curext;
-    uint32_t curseg_id = 0;
-    char *value;
-
-    for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        if (ctrl.zonemap->zones[i].extent_ctr == 0) {
-            continue;
-        }
 
-        current = ctrl.zonemap->zones[i].extents_head;
-        zone = json_object_new_object();
-        zone_segments = json_object_new_object();
-        extents = 0;
+    memset(&json_state, 0, sizeof(struct json_dump_state));
+    json_begin_object(&json_out, "zonemap");
 
-        while (current) {
-            extents++;
-            segment_id = (current->extent->phy_blk & ctrl.f2fs_segment_mask) >>
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        for (uint32_t j = 0; j < ctrl.zonemap->zones[i].extent_ctr; j++) {
+            current = ctrl.zonemap->zones[i].extents[j];
+            segment_id = (current->phy_blk & ctrl.f2fs_segment_mask) >>
                          ctrl.segment_shift;
             if ((segment_id << ctrl.segment_shift) >= end_lba) {
                 break;
@@ -427,123 +393,37 @@ static int json_dump_f2fs_zonemap() {
                 continue;
             }
 
-            if (current_zone != current->extent->zone) {
-                current_zone = current->extent->zone;
-            }
-
-            if (curseg_id != segment_id) {
-                /* Add all previously collected segments and extents to the
-                 * zonemap json, only if data has been written. First iteration
-                 * in the loop this array will be empty. */
-                if (json_object_array_length(curseg_extents) > 0) {
-                    json_object_object_add(curseg, "extents", curseg_extents);
-
-                    value = uint32_to_string_cast(segment_id);
-                    json_object_object_add(zone_segments, value, curseg);
-                    free(value);
-                }
-
-                curseg = json_object_new_object();
-                json_object_object_add(
-                    curseg, "seg_info",
-                    json_get_segment_info(current->extent, segment_id));
-                curseg_extents = json_object_new_array();
-
-                curseg_id = segment_id;
+            if (!json_state.zone_open) {
+                json_open_zone(current->zone);
             }
 
-            uint64_t segment_start =
-                (current->extent->phy_blk & ctrl.f2fs_segment_mask);
-            uint64_t extent_end =
-                current->extent->phy_blk + current->extent->len;
-
-            /* if the beginning of the extent and the ending of the extent are
-             * in the same segment */
-            if (segment_start == (extent_end & ctrl.f2fs_segment_mask) ||
-                extent_end == (segment_start +
-                               (F2FS_SEGMENT_BYTES >> ctrl.sector_shift))) {
-                if (segment_id != ctrl.cur_segment) {
-                    curext = json_object_new_object();
-
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_extent_info(current->extent));
-                    json_object_array_add(curseg_extents, curext);
-
-                    ctrl.cur_segment = segment_id;
-                } else {
-                    curext = json_object_new_object();
-
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_extent_info(current->extent));
-                    json_object_array_add(curseg_extents, curext);
-                }
-            } else {
-                /* Else the extent spans across multiple segments, so we need to
-                 * break it up */
-
-                /* part 1: the beginning of extent to end of that single segment
-                 */
-                if (current->extent->phy_blk != segment_start) {
-                    curext = json_object_new_object();
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_beginning_segment_extent_info(
-                            current->extent));
-                    json_object_array_add(curseg_extents, curext);
-                    segment_id++;
-                }
-
-                /* part 2: all in between segments after the 1st segment and the
-                 * last (in case the last is only partially used by the segment)
-                 * - checks if there are more than 1 segments after the start */
-                uint64_t segment_end =
-                    ((current->extent->phy_blk + current->extent->len) &
-                     ctrl.f2fs_segment_mask);
-                if ((segment_end - segment_start) >> ctrl.segment_shift > 1)
-                    json_add_consecutive_segments_extent_info(
-                        current->extent, segment_id, zone_segments);
-
-                /* part 3: any remaining parts of the last segment, which do not
-                 * fill the entire last segment only if the segment actually has
-                 * a remaining fragment */
-                if (segment_end !=
-                    current->extent->phy_blk + current->extent->len) {
-                    json_add_remainder_segment_extent_info(current->extent,
-                                                           curseg_extents);
-                }
-            }
-
-            current = current->next;
+            json_add_segment_extents(current);
         }
 
-        json_object_object_add(zone, "zone_info",
-                               json_get_zone_info(current_zone));
-        json_object_object_add(zone, "segments", zone_segments);
-
-        value = uint32_to_string_cast(current_zone);
-        json_object_object_add(zonemap, value, zone);
-        free(value);
+        json_close_zone();
     }
 
-    json_object_object_add(ctrl.json_root, "zonemap", zonemap);
+    json_end_object(&json_out);
 
     return EXIT_SUCCESS;
 }
 
+/*
+ * Write the zone map as json to ctrl.json_file. The zone map must be updated
+ * and sorted.
+ *
+ * */
 int json_dump_data() {
-    if (init_json_file() == EXIT_FAILURE)
-        return EXIT_FAILURE;
+    json_writer_open(&json_out, ctrl.json_file);
+    json_begin_object(&json_out, NULL);
+    json_add_info(&json_out);
 
     if (ctrl.fs_magic == F2FS_MAGIC)
         json_dump_f2fs_zonemap();
     // TODO: else just dump the zonemap to json
 
-    if (json_object_to_file(ctrl.json_file, ctrl.json_root) == EXIT_FAILURE)
-        ERR_MSG("Failed saving json data to %s\n", ctrl.json_file);
-
-    json_object_put(ctrl.json_root);
+    json_end_object(&json_out);
+    json_writer_close(&json_out, ctrl.json_file);
 
     return EXIT_SUCCESS;
 }
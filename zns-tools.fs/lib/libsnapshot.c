@@ -0,0 +1,399 @@
+#include "snapshot.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+/* table and width in bytes of each column */
+static const struct {
+    enum snap_table table;
+    uint32_t width;
+} snap_cols[SNAP_NR_COLS] = {
+    [SNAP_ZONE_START] = {SNAP_ZONES, sizeof(uint64_t)},
+    [SNAP_ZONE_CAP] = {SNAP_ZONES, sizeof(uint64_t)},
+    [SNAP_ZONE_WP] = {SNAP_ZONES, sizeof(uint64_t)},
+    [SNAP_ZONE_SIZE] = {SNAP_ZONES, sizeof(uint64_t)},
+    [SNAP_ZONE_STATE] = {SNAP_ZONES, sizeof(uint32_t)},
+    [SNAP_SEG_ID] = {SNAP_SEGMENTS, sizeof(uint64_t)},
+    [SNAP_SEG_TYPE] = {SNAP_SEGMENTS, sizeof(uint32_t)},
+    [SNAP_SEG_VALID] = {SNAP_SEGMENTS, sizeof(uint32_t)},
+    [SNAP_EXT_PBAS] = {SNAP_EXTENTS, sizeof(uint64_t)},
+    [SNAP_EXT_LEN] = {SNAP_EXTENTS, sizeof(uint64_t)},
+    [SNAP_EXT_LBAS] = {SNAP_EXTENTS, sizeof(uint64_t)},
+    [SNAP_EXT_FILE] = {SNAP_EXTENTS, sizeof(uint32_t)},
+    [SNAP_EXT_NR] = {SNAP_EXTENTS, sizeof(uint32_t)},
+    [SNAP_EXT_FLAGS] = {SNAP_EXTENTS, sizeof(uint32_t)},
+    [SNAP_EXT_ZONE] = {SNAP_EXTENTS, sizeof(uint32_t)},
+    [SNAP_FILE_PATH] = {SNAP_FILES, sizeof(uint64_t)},
+    [SNAP_FILE_EXTS] = {SNAP_FILES, sizeof(uint32_t)},
+    [SNAP_PATH_DATA] = {SNAP_PATHS, sizeof(char)},
+};
+
+static FILE *snap_fp;
+static uint64_t snap_off; /* current offset in the snapshot being written */
+
+static void snap_put(const void *data, size_t size) {
+    fwrite(data, size, 1, snap_fp);
+    snap_off += size;
+}
+
+static void snap_put_u64(uint64_t value) {
+    value = htole64(value);
+    snap_put(&value, sizeof(uint64_t));
+}
+
+static void snap_put_u32(uint32_t value) {
+    value = htole32(value);
+    snap_put(&value, sizeof(uint32_t));
+}
+
+/* pad the file to the column alignment and record the column offset */
+static void snap_begin_col(struct snap_header *hdr, enum snap_col col) {
+    static const char pad[SNAP_ALIGN];
+
+    if (snap_off % SNAP_ALIGN) {
+        snap_put(pad, SNAP_ALIGN - snap_off % SNAP_ALIGN);
+    }
+
+    hdr->cols[col] = htole64(snap_off);
+}
+
+/* copy a string into a zeroed header field, truncating it if needed */
+static void snap_set_str(char *field, size_t size, const char *str) {
+    memcpy(field, str, strnlen(str, size - 1));
+}
+
+static void snap_set_dev(struct snap_dev *dev, struct bdev *bdev) {
+    snap_set_str(dev->dev_name, SNAP_DEV_NAME_LEN, bdev->dev_name);
+    snap_set_str(dev->dev_path, SNAP_DEV_PATH_LEN, bdev->dev_path);
+    snap_set_str(dev->link_name, SNAP_DEV_PATH_LEN, bdev->link_name);
+    dev->is_zoned = htole32(bdev->is_zoned);
+    dev->zone_mask = htole32(bdev->zone_mask);
+    dev->nr_zones = htole64(bdev->nr_zones);
+    dev->zone_size = htole64(bdev->zone_size);
+}
+
+/*
+ * Walk the segments that are occupied by the extents of the zone map, in
+ * ascending id, and write one column of the segment table.
+ *
+ * @col: segment column to write, SNAP_NR_COLS to only count the segments
+ *
+ * returns: number of segments
+ *
+ * */
+static uint64_t snap_put_segments(enum snap_col col) {
+    struct segment_info seg_i, *info;
+    struct extent *extent;
+    uint64_t first, last, nr_segments = 0, prev = 0;
+
+    if (ctrl.fs_magic != F2FS_MAGIC || ctrl.fs_info_bytes == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        for (uint32_t j = 0; j < ctrl.zonemap->zones[i].extent_ctr; j++) {
+            extent = ctrl.zonemap->zones[i].extents[j];
+            first = (extent->phy_blk & ctrl.f2fs_segment_mask) >>
+                    ctrl.segment_shift;
+            last = ((extent->phy_blk + extent->len - 1) &
+                    ctrl.f2fs_segment_mask) >>
+                   ctrl.segment_shift;
+
+            for (uint64_t id = first; id <= last; id++) {
+                if (nr_segments > 0 && id <= prev) {
+                    continue;
+                }
+
+                /* fs_info of the extent is of the segment it starts in */
+                info = extent->fs_info;
+                if (id != first) {
+                    ctrl.fs_info_init(ctrl.fs_manager, &seg_i, id);
+                    info = &seg_i;
+                }
+
+                if (col == SNAP_SEG_ID) {
+                    snap_put_u64(id);
+                } else if (col == SNAP_SEG_TYPE) {
+                    snap_put_u32(info->type);
+                } else if (col == SNAP_SEG_VALID) {
+                    snap_put_u32(info->valid_blocks);
+                }
+
+                prev = id;
+                nr_segments++;
+            }
+        }
+    }
+
+    return nr_segments;
+}
+
+/* write one column of the extent table */
+static void snap_put_extents(enum snap_col col) {
+    struct extent *extent;
+
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        for (uint32_t j = 0; j < ctrl.zonemap->zones[i].extent_ctr; j++) {
+            extent = ctrl.zonemap->zones[i].extents[j];
+
+            switch (col) {
+            case SNAP_EXT_PBAS:
+                snap_put_u64(extent->phy_blk);
+                break;
+            case SNAP_EXT_LEN:
+                snap_put_u64(extent->len);
+                break;
+            case SNAP_EXT_LBAS:
+                snap_put_u64(extent->logical_blk);
+                break;
+            case SNAP_EXT_FILE:
+                snap_put_u32(extent->fileID);
+                break;
+            case SNAP_EXT_NR:
+                snap_put_u32(extent->ext_nr);
+                break;
+            case SNAP_EXT_FLAGS:
+                snap_put_u32(extent->flags);
+                break;
+            case SNAP_EXT_ZONE:
+                snap_put_u32(extent->zone);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/* write one column of the zone table */
+static void snap_put_zones(enum snap_col col) {
+    struct zone *zone;
+
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+
+        switch (col) {
+        case SNAP_ZONE_START:
+            snap_put_u64(zone->start);
+            break;
+        case SNAP_ZONE_CAP:
+            snap_put_u64(zone->capacity);
+            break;
+        case SNAP_ZONE_WP:
+            snap_put_u64(zone->wp);
+            break;
+        case SNAP_ZONE_SIZE:
+            snap_put_u64(zone->size);
+            break;
+        case SNAP_ZONE_STATE:
+            snap_put_u32(zone->state);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/*
+ * Write the zone map as a snapshot. The zone map must be updated and sorted,
+ * each column is written with a pass over the zone map, such that no memory
+ * is allocated for the columns.
+ *
+ * @file: path of the snapshot to write
+ *
+ * */
+void snap_write(char *file) {
+    struct snap_header hdr;
+    struct timespec ts;
+    char *buf;
+    uint64_t nr_files = 0, path_off = 0, path_len;
+    int err;
+
+    if (ctrl.file_counter_map) {
+        nr_files = ctrl.file_counter_map->file_ctr;
+    }
+
+    snap_fp = fopen(file, "w");
+    if (!snap_fp) {
+        ERR_MSG("Failed opening snapshot file %s\n", file);
+    }
+
+    buf = malloc(SNAP_WRITE_BUF_SZ);
+    if (!buf) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    setvbuf(snap_fp, buf, _IOFBF, SNAP_WRITE_BUF_SZ);
+
+    /* header is written last, once all column offsets are known */
+    memset(&hdr, 0, sizeof(struct snap_header));
+    snap_off = 0;
+    snap_put(&hdr, sizeof(struct snap_header));
+
+    for (int col = SNAP_ZONE_START; col <= SNAP_ZONE_STATE; col++) {
+        snap_begin_col(&hdr, col);
+        snap_put_zones(col);
+    }
+
+    for (int col = SNAP_SEG_ID; col <= SNAP_SEG_VALID; col++) {
+        snap_begin_col(&hdr, col);
+        snap_put_segments(col);
+    }
+
+    for (int col = SNAP_EXT_PBAS; col <= SNAP_EXT_ZONE; col++) {
+        snap_begin_col(&hdr, col);
+        snap_put_extents(col);
+    }
+
+    snap_begin_col(&hdr, SNAP_FILE_PATH);
+    for (uint64_t i = 0; i < nr_files; i++) {
+        snap_put_u64(path_off);
+        path_off += strlen(ctrl.file_counter_map->files[i].file) + 1;
+    }
+
+    snap_begin_col(&hdr, SNAP_FILE_EXTS);
+    for (uint64_t i = 0; i < nr_files; i++) {
+        snap_put_u32(ctrl.file_counter_map->files[i].ext_ctr);
+    }
+
+    snap_begin_col(&hdr, SNAP_PATH_DATA);
+    for (uint64_t i = 0; i < nr_files; i++) {
+        path_len = strlen(ctrl.file_counter_map->files[i].file) + 1;
+        snap_put(ctrl.file_counter_map->files[i].file, path_len);
+    }
+
+    memcpy(hdr.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+    hdr.version = htole32(SNAP_VERSION);
+    hdr.header_bytes = htole32(sizeof(struct snap_header));
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr.time = htole64(ts.tv_sec);
+    hdr.fs_magic = htole64(ctrl.fs_magic);
+    snap_set_str(hdr.program, SNAP_PROGRAM_LEN, ctrl.argv);
+    snap_set_dev(&hdr.bdev, &ctrl.bdev);
+    snap_set_dev(&hdr.znsdev, &ctrl.znsdev);
+    hdr.multi_dev = htole32(ctrl.multi_dev);
+    hdr.sector_size = htole32(ctrl.sector_size);
+    hdr.sector_shift = htole32(ctrl.sector_shift);
+    hdr.segment_shift = htole32(ctrl.segment_shift);
+    hdr.f2fs_segment_sectors = htole64(ctrl.f2fs_segment_sectors);
+    hdr.f2fs_segment_mask = htole64(ctrl.f2fs_segment_mask);
+    hdr.rows[SNAP_ZONES] = htole64(ctrl.zonemap->nr_zones);
+    hdr.rows[SNAP_SEGMENTS] = htole64(snap_put_segments(SNAP_NR_COLS));
+    hdr.rows[SNAP_EXTENTS] = htole64(ctrl.zonemap->extent_ctr);
+    hdr.rows[SNAP_FILES] = htole64(nr_files);
+    hdr.rows[SNAP_PATHS] = htole64(path_off);
+
+    fseeko(snap_fp, 0, SEEK_SET);
+    fwrite(&hdr, sizeof(struct snap_header), 1, snap_fp);
+
+    err = ferror(snap_fp);
+    if (fclose(snap_fp) || err) {
+        ERR_MSG("Failed saving snapshot to %s\n", file);
+    }
+
+    free(buf);
+    snap_fp = NULL;
+}
+
+/*
+ * Map a snapshot and validate its header and columns, such that the
+ * accessors can be used on any row of the tables.
+ *
+ * @snap: struct snapshot * to initialize
+ * @file: path of the snapshot
+ *
+ * */
+void snap_open(struct snapshot *snap, char *file) {
+    struct stat st;
+    uint64_t off, rows, nr_paths;
+
+    snap->fd = open(file, O_RDONLY);
+    if (snap->fd < 0) {
+        ERR_MSG("Failed opening snapshot %s\n", file);
+    }
+
+    if (fstat(snap->fd, &st) < 0) {
+        ERR_MSG("Failed stat on snapshot %s\n", file);
+    }
+
+    snap->size = st.st_size;
+    if (snap->size < sizeof(struct snap_header)) {
+        ERR_MSG("%s is not a zns-tools snapshot\n", file);
+    }
+
+    snap->map = mmap(NULL, snap->size, PROT_READ, MAP_SHARED, snap->fd, 0);
+    if (snap->map == MAP_FAILED) {
+        ERR_MSG("Failed mapping snapshot %s\n", file);
+    }
+    snap->hdr = (struct snap_header *)snap->map;
+
+    if (memcmp(snap->hdr->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC))) {
+        ERR_MSG("%s is not a zns-tools snapshot\n", file);
+    }
+
+    if (le32toh(snap->hdr->version) != SNAP_VERSION ||
+        le32toh(snap->hdr->header_bytes) != sizeof(struct snap_header)) {
+        ERR_MSG("Unsupported snapshot version %u of %s\n",
+                le32toh(snap->hdr->version), file);
+    }
+
+    for (int col = 0; col < SNAP_NR_COLS; col++) {
+        off = le64toh(snap->hdr->cols[col]);
+        rows = snap_rows(snap, snap_cols[col].table);
+
+        if (off % SNAP_ALIGN || off < sizeof(struct snap_header) ||
+            off > snap->size ||
+            rows > (snap->size - off) / snap_cols[col].width) {
+            ERR_MSG("Snapshot %s is truncated or corrupted\n", file);
+        }
+    }
+
+    /* paths must be null terminated inside of the path table */
+    nr_paths = snap_rows(snap, SNAP_PATHS);
+    for (uint64_t i = 0; i < snap_rows(snap, SNAP_FILES); i++) {
+        if (snap_u64(snap, SNAP_FILE_PATH, i) >= nr_paths) {
+            ERR_MSG("Snapshot %s is truncated or corrupted\n", file);
+        }
+    }
+
+    if (nr_paths > 0 && snap->map[le64toh(snap->hdr->cols[SNAP_PATH_DATA]) +
+                                  nr_paths - 1] != '\0') {
+        ERR_MSG("Snapshot %s is truncated or corrupted\n", file);
+    }
+}
+
+void snap_close(struct snapshot *snap) {
+    munmap((void *)snap->map, snap->size);
+    close(snap->fd);
+    snap->map = NULL;
+    snap->hdr = NULL;
+}
+
+/*
+ * Find a segment in the segment table of a snapshot.
+ *
+ * @snap: struct snapshot * to search
+ * @id: segment id, relative to the ZNS device
+ *
+ * returns: row of the segment, SNAP_SEGMENT_NOT_FOUND if the snapshot has no
+ * extents in the segment
+ *
+ * */
+uint64_t snap_find_segment(struct snapshot *snap, uint64_t id) {
+    uint64_t lo = 0, hi = snap_rows(snap, SNAP_SEGMENTS), mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (snap_u64(snap, SNAP_SEG_ID, mid) < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < snap_rows(snap, SNAP_SEGMENTS) &&
+        snap_u64(snap, SNAP_SEG_ID, lo) == id) {
+        return lo;
+    }
+
+    return SNAP_SEGMENT_NOT_FOUND;
+}
@@ -105,54 +105,72 @@ void init_dev(struct stat *st) {
 }
 
 /*
- * initialize the zone map with the zone information,
- * allocate all space for the zones.
+ * Update the zone information in the zone map with a single report of all
+ * zones on the ZNS device. The zone map acts as the cache of zone information
+ * for all lookups (extent zone info, zone printing, json dumping), such that
+ * the device is not opened and reported for each extent or zone.
+ *
+ * Can be called at any point to refresh the WP and state of all zones.
  *
- * Zone WP and state are initialized but will be updated
- * during reporting, for each zone at the time of reporting.
+ * returns: EXIT_SUCCESS on success, EXIT_FAILURE on failure
  *
  * */
-static void init_zone_map() {
+int update_zone_map() {
     struct blk_zone_report *hdr = NULL;
+    struct zone *zone;
 
     int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
     if (fd < 0) {
-        return;
+        return EXIT_FAILURE;
     }
 
     hdr = calloc(1, sizeof(struct blk_zone_report) +
-                        sizeof(struct blk_zone) * ctrl.znsdev.nr_zones);
+                        sizeof(struct blk_zone) * ctrl.zonemap->nr_zones);
     hdr->sector = 0;
-    hdr->nr_zones = ctrl.znsdev.nr_zones;
+    hdr->nr_zones = ctrl.zonemap->nr_zones;
 
     if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
         ERR_MSG("getting Zone Info\n");
-        return;
+        return EXIT_FAILURE;
     }
 
-    ctrl.zonemap = calloc(1, sizeof(struct zone_map) +
-                                 sizeof(struct zone) * ctrl.znsdev.nr_zones);
-    // TODO: later we want multi zns device support
-    ctrl.zonemap->nr_zones = ctrl.znsdev.nr_zones;
-
-    for (int i = 0; i < ctrl.znsdev.nr_zones; i++) {
-        ctrl.zonemap->zones[i].zone_number = i;
-        ctrl.zonemap->zones[i].start =
-            hdr->zones[i].start >> ctrl.zns_sector_shift;
-        ctrl.zonemap->zones[i].end =
-            (hdr->zones[i].start >> ctrl.zns_sector_shift) +
-            (hdr->zones[i].capacity >> ctrl.zns_sector_shift);
-        ctrl.zonemap->zones[i].capacity =
-            hdr->zones[i].capacity >> ctrl.zns_sector_shift;
-        ctrl.zonemap->zones[i].state = hdr->zones[i].cond << 4;
-        ctrl.zonemap->zones[i].mask = ctrl.znsdev.zone_mask;
-        ctrl.zonemap->zones[i].extents_head = NULL;
+    for (uint32_t i = 0; i < hdr->nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+
+        zone->zone_number = i;
+        zone->start = hdr->zones[i].start >> ctrl.zns_sector_shift;
+        zone->end = (hdr->zones[i].start >> ctrl.zns_sector_shift) +
+                    (hdr->zones[i].capacity >> ctrl.zns_sector_shift);
+        zone->capacity = hdr->zones[i].capacity >> ctrl.zns_sector_shift;
+        zone->wp = hdr->zones[i].wp >> ctrl.zns_sector_shift;
+        zone->size = hdr->zones[i].len >> ctrl.zns_sector_shift;
+        zone->state = hdr->zones[i].cond << 4;
+        zone->mask = ctrl.znsdev.zone_mask;
     }
 
     close(fd);
 
     free(hdr);
     hdr = NULL;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * initialize the zone map with the zone information,
+ * allocate all space for the zones.
+ *
+ * Zone WP and state are initialized but can be updated with
+ * update_zone_map(), which is done at the time of reporting.
+ *
+ * */
+static void init_zone_map() {
+    ctrl.zonemap = calloc(1, sizeof(struct zone_map) +
+                                 sizeof(struct zone) * ctrl.znsdev.nr_zones);
+    // TODO: later we want multi zns device support
+    ctrl.zonemap->nr_zones = ctrl.znsdev.nr_zones;
+
+    update_zone_map();
 }
 
 /*
@@ -270,9 +288,23 @@ uint32_t get_nr_zones() {
  *
  * */
 void cleanup_ctrl() {
+    struct path_chunk *chunk, *next;
+
     cleanup_zonemap();
 
+    if (ctrl.file_counter_map != NULL) {
+        for (chunk = ctrl.file_counter_map->paths; chunk != NULL;
+             chunk = next) {
+            next = chunk->next;
+            free(chunk);
+        }
+    }
+
     free(ctrl.file_counter_map);
+
+    if (ctrl.fs_magic == F2FS_MAGIC) {
+        f2fs_close_devs();
+    }
 }
 
 /*
@@ -280,114 +312,174 @@ void cleanup_ctrl() {
  *
  * */
 void cleanup_zonemap() {
-    struct node *head;
-    struct node *next;
+    struct extent_slab *slab, *next;
 
     for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        head = ctrl.zonemap->zones[i].extents_head;
-        while (head != NULL) {
-            next = head->next;
-            free(head->extent);
-            free(head);
-            head = next;
-        }
+        free(ctrl.zonemap->zones[i].extents);
+    }
+
+    for (slab = ctrl.zonemap->slabs; slab != NULL; slab = next) {
+        next = slab->next;
+        free(slab);
     }
 }
 
-// TODO: description
-// this was the btree part, if we go back to it. for now linked list is simplest
-// later on especially as we only insert and never delete nodes (maybe later
-// with extent caching we change it)
-//
-
-/* static struct node* create_zone_btree_node(struct extent *extent) { */
-/*     struct node *new_node= calloc(1, sizeof(struct node)); */
-
-/*     new_node->extent = extent; */
-/*     new_node->left = NULL; */
-/*     new_node->right = NULL; */
-
-/*     return new_node; */
-/* } */
-
-/* // TODO: description */
-/* static void insert_zone_btree_node(struct node *root, struct node *node) { */
-/*     // TODO: for concurrency spinlock here */
-
-/*     if (root->extent->phy_blk > node->extent->phy_blk) { */
-/*         if (root->left) { */
-/*             insert_zone_btree_node(root->left, node); */
-/*         } else { */
-/*             root->left = node; */
-/*         } */
-/*     } else { */
-/*         if (root->right) { */
-/*             insert_zone_btree_node(root->left, node); */
-/*         } else { */
-/*             root->left = node; */
-/*         } */
-/*     } */
-/* } */
-
-/* // TODO: description */
-/* // TODO: cleanup btree in the end (free all mallocs) */
-/* static void add_extent_to_zone_btree(struct extent *extent) { */
-/*     struct node *node = create_zone_btree_node(extent); */
-
-/*     ctrl.zonemap.zones[extent->zone].extent_ctr++; */
-
-/*     if (!ctrl.zonemap.zones[extent->zone].btree) { */
-/*         ctrl.zonemap.zones[extent->zone].btree = node; */
-/*     } else { */
-/*         insert_zone_btree_node(ctrl.zonemap.zones[extent->zone].btree, node);
- */
-/*     } */
-/* } */
-
-// TODO: description
-static struct node *create_zone_extent_node(struct extent *extent) {
-    struct node *node = calloc(1, sizeof(struct node));
-
-    node->extent = calloc(1, sizeof(struct extent));
-    memcpy(node->extent, extent, sizeof(struct extent));
-    if (extent->fs_info) {
-        node->extent->fs_info = calloc(1, ctrl.fs_info_bytes);
-        memcpy(node->extent->fs_info, extent->fs_info, ctrl.fs_info_bytes);
+/*
+ * Allocate a zeroed extent from the extent slabs of the zone map. The
+ * fs_info of the extent (if the file system sets fs_info_bytes) is placed
+ * directly after the extent in the same slot. Extents are never freed
+ * individually, cleanup_zonemap() frees all slabs.
+ *
+ * returns: struct extent * to the extent, NULL on failure
+ *
+ * */
+static struct extent *alloc_extent() {
+    struct extent_slab *slab = ctrl.zonemap->slabs;
+    struct extent *extent;
+    uint32_t slot_size;
+
+    if (slab == NULL || slab->used == EXTENT_SLAB_ENTRIES) {
+        /* keep the fs_info of the slot aligned */
+        slot_size = (sizeof(struct extent) + ctrl.fs_info_bytes + 7) & ~7;
+
+        slab = calloc(1, sizeof(struct extent_slab) +
+                             (size_t)slot_size * EXTENT_SLAB_ENTRIES);
+        if (slab == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+            return NULL;
+        }
+
+        slab->slot_size = slot_size;
+        slab->next = ctrl.zonemap->slabs;
+        ctrl.zonemap->slabs = slab;
     }
 
-    node->next = NULL;
+    extent =
+        (struct extent *)&slab->slots[(size_t)slab->used * slab->slot_size];
+    slab->used++;
 
-    return node;
+    if (ctrl.fs_info_bytes > 0) {
+        extent->fs_info = (char *)extent + sizeof(struct extent);
+    }
+
+    return extent;
 }
 
-static void insert_zone_list_head(struct node **head, struct node *node) {
-    *head = node;
+/*
+ * Add an extent to the extents of its zone. Extents are only appended during
+ * collection, sort_zone_map() sorts them once all extents are collected.
+ *
+ * @extent: struct extent * to add, must be allocated with alloc_extent()
+ *
+ * */
+static void add_extent_to_zone(struct extent *extent) {
+    struct zone *zone = &ctrl.zonemap->zones[extent->zone];
+    struct extent **temp = NULL;
+
+    if (zone->extent_ctr == zone->extent_cap) {
+        zone->extent_cap = zone->extent_cap == 0 ? ZONE_EXTENTS_MIN_ENTRIES
+                                                 : zone->extent_cap << 1;
+        temp =
+            realloc(zone->extents, sizeof(struct extent *) * zone->extent_cap);
+        if (temp == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        zone->extents = temp;
+    }
+
+    /* files are mostly appended in order, only unsorted zones are sorted */
+    if (zone->extent_ctr == 0) {
+        zone->sorted = 1;
+    } else if (zone->extents[zone->extent_ctr - 1]->phy_blk > extent->phy_blk) {
+        zone->sorted = 0;
+    }
+
+    zone->extents[zone->extent_ctr] = extent;
+    zone->extent_ctr++;
 }
 
-static void sorted_zone_list_insert(struct node **head, struct node *node) {
-    struct node **current = head;
+/*
+ * LSD radix sort of extents on their phy_blk, one byte per pass. Passes in
+ * which all extents have the same byte value are skipped, which, as all
+ * extents of a zone share the upper bits of their address, leaves only a
+ * few passes per zone. The sort is stable, extents with equal phy_blk
+ * remain in the order they were added.
+ *
+ * @extents: struct extent ** array of extents to sort
+ * @tmp: struct extent ** scratch array with at least nr entries
+ * @nr: number of extents in the array
+ *
+ * */
+static void radix_sort_extents(struct extent **extents, struct extent **tmp,
+                               uint32_t nr) {
+    struct extent **src = extents, **dst = tmp, **swap;
+    uint32_t count[256];
+    uint32_t offset, digit;
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        memset(count, 0, sizeof(count));
 
-    while (*current != NULL &&
-           (*current)->extent->phy_blk < node->extent->phy_blk) {
-        current = &((*current)->next);
+        for (uint32_t i = 0; i < nr; i++) {
+            count[(src[i]->phy_blk >> shift) & 0xff]++;
+        }
+
+        if (count[(src[0]->phy_blk >> shift) & 0xff] == nr) {
+            continue;
+        }
+
+        offset = 0;
+        for (uint32_t i = 0; i < 256; i++) {
+            digit = count[i];
+            count[i] = offset;
+            offset += digit;
+        }
+
+        for (uint32_t i = 0; i < nr; i++) {
+            dst[count[(src[i]->phy_blk >> shift) & 0xff]++] = src[i];
+        }
+
+        swap = src;
+        src = dst;
+        dst = swap;
     }
 
-    node->next = *current;
-    *current = node;
+    if (src != extents) {
+        memcpy(extents, src, sizeof(struct extent *) * nr);
+    }
 }
 
-static void add_extent_to_zone_list(struct extent extent) {
-    struct node *node = create_zone_extent_node(&extent);
+/*
+ * Sort the extents of all zones in the zone map by their phy_blk. Zones that
+ * are already sorted are skipped, hence this can be called by each report
+ * before iterating the zone map.
+ *
+ * */
+void sort_zone_map() {
+    struct extent **tmp = NULL;
+    uint32_t tmp_cap = 0;
+    struct zone *zone;
 
-    if (ctrl.zonemap->zones[extent.zone].extent_ctr == 0) {
-        insert_zone_list_head(&ctrl.zonemap->zones[extent.zone].extents_head,
-                              node);
-    } else {
-        sorted_zone_list_insert(&ctrl.zonemap->zones[extent.zone].extents_head,
-                                node);
+    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+
+        if (zone->sorted || zone->extent_ctr == 0) {
+            continue;
+        }
+
+        if (zone->extent_ctr > tmp_cap) {
+            free(tmp);
+            tmp_cap = zone->extent_ctr;
+            tmp = malloc(sizeof(struct extent *) * tmp_cap);
+            if (tmp == NULL) {
+                ERR_MSG("Failed memory allocation\n");
+            }
+        }
+
+        radix_sort_extents(zone->extents, tmp, zone->extent_ctr);
+        zone->sorted = 1;
     }
 
-    ctrl.zonemap->zones[extent.zone].extent_ctr++;
+    free(tmp);
 }
 
 /*
@@ -409,85 +501,20 @@ uint32_t get_zone_number(uint64_t lba) {
 }
 
 /*
- * Print the information about a zone.
+ * Print the information about a zone, as cached in the zone map.
  *
  * @zone: number of the zone to print info of
  *
  * */
 void print_zone_info(uint32_t zone) {
-    unsigned long long start_sector = 0;
-    struct blk_zone_report *hdr = NULL;
-
-    start_sector = (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * zone;
-
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
-    if (fd < 0) {
-        return;
-    }
-
-    hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
-    hdr->nr_zones = 1;
-
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return;
-    }
+    struct zone *z = &ctrl.zonemap->zones[zone];
 
     MSG("\n============ ZONE %d ============\n", zone);
-    MSG("LBAS: 0x%06llx  LBAE: 0x%06llx  CAP: 0x%06llx  WP: 0x%06llx  SIZE: "
-        "0x%06llx  STATE: %#-4x  MASK: 0x%06" PRIx32 "\n",
-        hdr->zones[0].start >> ctrl.zns_sector_shift,
-        (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-            (hdr->zones[0].capacity >> ctrl.zns_sector_shift),
-        hdr->zones[0].capacity >> ctrl.zns_sector_shift,
-        hdr->zones[0].wp >> ctrl.zns_sector_shift,
-        hdr->zones[0].len >> ctrl.zns_sector_shift, hdr->zones[0].cond << 4,
+    MSG("LBAS: 0x%06" PRIx64 "  LBAE: 0x%06" PRIx64 "  CAP: 0x%06" PRIx64
+        "  WP: 0x%06" PRIx64 "  SIZE: 0x%06" PRIx64 "  STATE: %#-4x  MASK: "
+        "0x%06" PRIx32 "\n",
+        z->start, z->end, z->capacity, z->wp, z->size, z->state,
         ctrl.znsdev.zone_mask);
-
-    close(fd);
-
-    free(hdr);
-    hdr = NULL;
-}
-
-/*
- * Get information about a zone.
- *
- * @extent: struct extent * to store zone info in
- *
- * */
-static void get_zone_info(struct extent *extent) {
-    struct blk_zone_report *hdr = NULL;
-    uint64_t start_sector;
-
-    start_sector =
-        (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * extent->zone;
-
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
-    if (fd < 0) {
-        return;
-    }
-
-    hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
-    hdr->nr_zones = 1;
-
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return;
-    }
-
-    extent->zone_wp = hdr->zones[0].wp >> ctrl.zns_sector_shift;
-    extent->zone_lbae = (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-                        (hdr->zones[0].capacity >> ctrl.zns_sector_shift);
-    extent->zone_cap = hdr->zones[0].capacity >> ctrl.zns_sector_shift;
-    extent->zone_lbas = hdr->zones[0].start >> ctrl.zns_sector_shift;
-
-    close(fd);
-
-    free(hdr);
-    hdr = NULL;
 }
 
 /*
@@ -531,186 +558,454 @@ void show_extent_flags(uint32_t flags) {
     MSG("\n");
 }
 
+/*
+ * Store a file path in the path chunks of the file_counter_map. Each file is
+ * only stored once, as it gets a single entry in the file_counter_map, which
+ * all its extents reference with their fileID. Paths are never freed
+ * individually, cleanup_ctrl() frees all chunks.
+ *
+ * @file: char * to file name (full path)
+ *
+ * returns: char * to the stored path, NULL on failure
+ *
+ * */
+static char *store_file_path(char *file) {
+    struct path_chunk *chunk = ctrl.file_counter_map->paths;
+    uint32_t len = strlen(file) + 1;
+    uint32_t size = PATH_CHUNK_BYTES;
+    char *path;
+
+    if (chunk == NULL || chunk->size - chunk->used < len) {
+        if (len > size) {
+            size = len;
+        }
+
+        chunk = malloc(sizeof(struct path_chunk) + size);
+        if (chunk == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+            return NULL;
+        }
+
+        chunk->used = 0;
+        chunk->size = size;
+        chunk->next = ctrl.file_counter_map->paths;
+        ctrl.file_counter_map->paths = chunk;
+    }
+
+    path = &chunk->data[chunk->used];
+    memcpy(path, file, len);
+    chunk->used += len;
+
+    return path;
+}
+
 /*
  * Increase the extent counts for a particular file
  *
+ * Files are mapped one at a time, hence the counter of the file currently
+ * being mapped is always the last entry in the file_counter_map. A new entry
+ * is created on the first mapped extent of a file, and its index is the
+ * fileID of all extents of the file.
+ *
  * @file: char * to file name (full path)
+ * @new_file: 1 if this is the first mapped extent of the file
+ *
+ * returns: uint32_t fileID (index in the file_counter_map) of the file
  *
  * */
-static void increase_file_extent_counter(char *file) {
-    for (uint32_t i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strcmp(ctrl.file_counter_map->files[i].file, file) == 0) {
-            ctrl.file_counter_map->files[i].ext_ctr++;
-            return;
+static uint32_t increase_file_extent_counter(char *file, uint8_t new_file) {
+    struct file_counter_map *map = ctrl.file_counter_map;
+    struct file_counter *counter;
+
+    if (new_file) {
+        counter = &map->files[map->file_ctr];
+        counter->file = store_file_path(file);
+        map->file_ctr++;
+    }
+
+    counter = &map->files[map->file_ctr - 1];
+    counter->ext_ctr++;
+
+    return map->file_ctr - 1;
+}
+
+/*
+ * Reserve space in the file_counter_map for a number of files. The map is
+ * never shrunk, and growing it by more than a single entry at a time (e.g.,
+ * doubling it when full or reserving a hint of the number of files up front)
+ * avoids reallocating and copying the entire map for each file.
+ *
+ * @nr_files: uint32_t number of files to reserve space for
+ *
+ * returns: EXIT_SUCCESS on success, EXIT_FAILURE on failure
+ *
+ * */
+int reserve_file_counter_map(uint32_t nr_files) {
+    struct file_counter_map *temp = NULL;
+    struct path_chunk *paths = NULL;
+    uint32_t file_ctr = 0, file_cap = 0;
+
+    if (ctrl.file_counter_map != NULL) {
+        paths = ctrl.file_counter_map->paths;
+        file_ctr = ctrl.file_counter_map->file_ctr;
+        file_cap = ctrl.file_counter_map->file_cap;
+    }
+
+    if (nr_files <= file_cap) {
+        return EXIT_SUCCESS;
+    }
+
+    temp = realloc(ctrl.file_counter_map,
+                   sizeof(struct file_counter_map) +
+                       sizeof(struct file_counter) * nr_files);
+    if (temp == NULL) {
+        /* mem realloc failed */
+        free(ctrl.file_counter_map);
+        ERR_MSG("Failed memory allocation\n");
+        return EXIT_FAILURE;
+    }
+
+    ctrl.file_counter_map = temp;
+    memset(&ctrl.file_counter_map->files[file_cap], 0,
+           sizeof(struct file_counter) * (nr_files - file_cap));
+    ctrl.file_counter_map->paths = paths;
+    ctrl.file_counter_map->file_ctr = file_ctr;
+    ctrl.file_counter_map->file_cap = nr_files;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Check if an address on the ZNS device is in the zone range from
+ * ctrl.start_zone to ctrl.end_zone, using the same bounds as the segment
+ * report, such that an extent is only collected if the report shows it.
+ *
+ * @phy_blk: uint64_t address on the ZNS device (in sectors)
+ *
+ * returns: 1 if the address is in the zone range, else 0
+ *
+ * */
+static int in_zone_range(uint64_t phy_blk) {
+    uint64_t start_lba =
+        ctrl.start_zone * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
+    uint64_t end_lba = (uint64_t)ctrl.end_zone * ctrl.znsdev.zone_size;
+
+    return phy_blk >= start_lba && phy_blk < end_lba;
+}
+
+/*
+ * Check if an extent returned by FIEMAP is numbered in its file, which are all
+ * extents that map_fiemap_extent() does not disregard for their location or
+ * flags.
+ *
+ * @fe: struct fiemap_extent * as returned by the ioctl()
+ *
+ * returns: 1 if the extent is numbered, else 0
+ *
+ * */
+static int is_numbered_extent(struct fiemap_extent *fe) {
+    return !(fe->fe_flags & (FIEMAP_EXTENT_DELALLOC | ctrl.exclude_flags)) &&
+           fe->fe_physical >= ctrl.offset;
+}
+
+/*
+ * Add a single extent returned by FIEMAP to the zonemap, unless it is
+ * located on the conventional device or has flags set that are excluded.
+ * With ctrl.zone_range_only, extents outside of the zone range are counted
+ * but dropped before any memory is allocated for them. Most of them are
+ * already dropped by retrieve_extents(), only inlined extents reach this.
+ *
+ * @filename: char * to the file name (full path) the extent belongs to
+ * @fe: struct fiemap_extent * as returned by the ioctl()
+ * @ext_nr: number of the extent in the logical order of the file
+ * @new_file: 1 if no prior extent of the file was added to the zonemap
+ *
+ * returns: 1 if the extent was added to the zonemap, -1 if it was dropped
+ * for being outside of the zone range, else 0
+ *
+ * */
+static int map_fiemap_extent(char *filename, struct fiemap_extent *fe,
+                             uint32_t ext_nr, uint8_t new_file) {
+    struct extent *extent;
+    uint64_t phy_blk;
+
+    /* If data is on the bdev (empty files that have space allocated but
+     * nothing written) or there are flags we want to ignore (inline data)
+     * Disregard this extent but print warning (if logging is set) */
+    if (fe->fe_flags & FIEMAP_EXTENT_DELALLOC) {
+        /* not yet written (only without syncing), has no physical location */
+        INFO(2,
+             "FILE %s\nDelayed allocation extent  LBAS: 0x%06llx  SIZE: "
+             "0x%06llx\n",
+             filename, fe->fe_logical >> ctrl.sector_shift,
+             fe->fe_length >> ctrl.sector_shift);
+
+        return 0;
+    } else if (fe->fe_physical < ctrl.offset) {
+        INFO(2,
+             "FILE %s\nExtent Reported on %s  PBAS: "
+             "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
+             filename, ctrl.bdev.dev_name, fe->fe_physical >> ctrl.sector_shift,
+             (fe->fe_physical + fe->fe_length) >> ctrl.sector_shift,
+             fe->fe_length >> ctrl.sector_shift);
+
+        if (ctrl.log_level > 1 && ctrl.show_flags) {
+            show_extent_flags(fe->fe_flags);
         }
+
+        return 0;
+    } else if (fe->fe_flags & ctrl.exclude_flags) {
+        INFO(2,
+             "FILE %s\nExtent Reported on %s  PBAS: "
+             "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
+             filename, ctrl.bdev.dev_name, fe->fe_physical >> ctrl.sector_shift,
+             (fe->fe_physical + fe->fe_length) >> ctrl.sector_shift,
+             fe->fe_length >> ctrl.sector_shift);
+
+        if (ctrl.log_level > 1) {
+            show_extent_flags(fe->fe_flags);
+            MSG("Disregarding extent because exclude flag is set to:\n");
+            show_extent_flags(ctrl.exclude_flags);
+        }
+
+        return 0;
+    }
+
+    phy_blk = (fe->fe_physical - ctrl.offset) >> ctrl.sector_shift;
+    if (ctrl.zone_range_only && !in_zone_range(phy_blk)) {
+        ctrl.range_extent_ctr++;
+
+        return -1;
+    }
+
+    extent = alloc_extent();
+    if (extent == NULL) {
+        return 0;
+    }
+
+    extent->phy_blk = phy_blk;
+    extent->logical_blk = fe->fe_logical >> ctrl.sector_shift;
+    extent->len = fe->fe_length >> ctrl.sector_shift;
+    extent->ext_nr = ext_nr; /* individual extent counter for each
+                                map_file_extents() scope -> each file */
+    extent->flags = fe->fe_flags;
+
+    ctrl.zonemap->cum_extent_size += extent->len;
+
+    extent->zone = get_zone_number((extent->phy_blk << ctrl.zns_sector_shift));
+
+    extent->fileID = increase_file_extent_counter(filename, new_file);
+
+    if (ctrl.fs_info_bytes > 0) {
+        /* only init if file system has fs_info setup */
+        ctrl.fs_info_init(ctrl.fs_manager, extent->fs_info,
+                          (extent->phy_blk & ctrl.f2fs_segment_mask) >>
+                              ctrl.segment_shift);
     }
 
-    strncpy(ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr].file,
-            file,
-            sizeof(ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr]
-                       .file));
-    ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr].ext_ctr = 1;
-    ctrl.file_counter_map->file_ctr++;
+    add_extent_to_zone(extent);
+
+    ctrl.zonemap->extent_ctr++;
+    ctrl.zonemap->zone_ctr++;
+
+    return 1;
 }
 
 /*
- * TODO: description and return codes
+ * Retrieve all extents of a file with FIEMAP and append them to a buffer.
+ *
+ * Extents are retrieved in batches of FIEMAP_EXTENT_BATCH, using the same
+ * fixed-size struct fiemap for every ioctl() call, such that the number of
+ * calls scales with the number of extents divided by the batch size, and
+ * not with the number of extents (or blocks) of the file. Only the first
+ * call sets FIEMAP_FLAG_SYNC, as the file is synced at that point already,
+ * and with ctrl.no_sync no call sets it, such that dirty data of the file is
+ * not written back and is returned as FIEMAP_EXTENT_DELALLOC extents.
+ *
+ * With ctrl.zone_range_only, extents outside of the zone range are counted in
+ * buf->range_extent_ctr and not appended, such that the buffer only holds the
+ * extents of the requested zones. Each appended extent keeps its number in the
+ * file in fe_reserved[FIEMAP_EXT_NR], and buf->file_ext_ctr is set to the
+ * number of extents of the file, including the dropped extents. Inlined
+ * extents are always appended, such that map_file_extents() counts them.
+ *
+ * Only the buffer is modified, hence different threads can retrieve extents
+ * concurrently into their own buffers, and map them with map_file_extents()
+ * afterwards.
+ *
+ * @fd: open file descriptor of the file
+ * @buf: struct fiemap_buffer * to append the extents to
+ *
+ * returns: EXIT_SUCCESS on success, EXIT_FAILURE on failure
  *
  * */
-int get_extents(char *filename, int fd, struct stat *stats) {
+int retrieve_extents(int fd, struct fiemap_buffer *buf) {
     struct fiemap *fiemap;
-    struct extent *extent;
+    struct fiemap_extent *fe = NULL, *temp = NULL;
+    uint32_t nr_extents;
     uint8_t last_ext = 0;
-    uint64_t ext_ctr = 0;
-    struct file_counter_map *temp = NULL;
+
+    buf->file_ext_ctr = 0;
 
     fiemap = calloc(1, sizeof(struct fiemap) +
-                           sizeof(struct fiemap_extent) * stats->st_blocks);
-    extent = calloc(1, sizeof(struct extent));
+                           sizeof(struct fiemap_extent) * FIEMAP_EXTENT_BATCH);
 
-    fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+    fiemap->fm_flags = ctrl.no_sync ? 0 : FIEMAP_FLAG_SYNC;
     fiemap->fm_start = 0;
-    fiemap->fm_extent_count =
-        stats->st_blocks; /* set to max number of blocks in file */
-    fiemap->fm_length =
-        (stats->st_blocks
-         << 3); /* st_blocks is always 512B units, shift to bytes */
-
-    /* (re)allocate the file_counter_map here as this function is always called
-     * for a single file */
-    if (ctrl.file_counter_map == NULL) {
-        ctrl.file_counter_map = calloc(1, sizeof(struct file_counter_map) +
-                                              sizeof(struct file_counter));
-    } else {
-        temp = realloc(ctrl.file_counter_map,
-                       sizeof(struct file_counter_map) +
-                           sizeof(struct file_counter) * (ctrl.nr_files + 1));
-        if (temp == NULL) {
-            /* mem realloc failed */
-            free(ctrl.file_counter_map);
-            ERR_MSG("Failed memory allocation\n");
-            return EXIT_FAILURE;
-        }
-        ctrl.file_counter_map = temp;
-        temp = NULL;
-        memset(&ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr],
-               0, sizeof(struct file_counter));
-    }
+    fiemap->fm_extent_count = FIEMAP_EXTENT_BATCH;
+    fiemap->fm_length = FIEMAP_MAX_OFFSET;
 
     do {
         if (ioctl(fd, FS_IOC_FIEMAP, fiemap) < 0) {
+            free(fiemap);
             return EXIT_FAILURE;
         }
 
-        if (fiemap->fm_mapped_extents == 0) {
-            ERR_MSG("no extents are mapped\n");
-            return EXIT_FAILURE;
+        nr_extents = fiemap->fm_mapped_extents;
+        if (nr_extents == 0) {
+            if (fiemap->fm_start == 0) {
+                ERR_MSG("no extents are mapped\n");
+                free(fiemap);
+                return EXIT_FAILURE;
+            }
+            /* Previous batch ended exactly at the last extent of the file */
+            break;
         }
 
-        /* If data is on the bdev (empty files that have space allocated but
-         * nothing written) or there are flags we want to ignore (inline data)
-         * Disregard this extent but print warning (if logging is set) */
-        if (fiemap->fm_extents[0].fe_physical < ctrl.offset) {
-            INFO(2,
-                 "FILE %s\nExtent Reported on %s  PBAS: "
-                 "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
-                 filename, ctrl.bdev.dev_name,
-                 fiemap->fm_extents[0].fe_physical >> ctrl.sector_shift,
-                 (fiemap->fm_extents[0].fe_physical +
-                  fiemap->fm_extents[0].fe_length) >>
-                     ctrl.sector_shift,
-                 fiemap->fm_extents[0].fe_length >> ctrl.sector_shift);
-
-            if (ctrl.log_level > 1 && ctrl.show_flags) {
-                show_extent_flags(fiemap->fm_extents[0].fe_flags);
-            }
-        } else if (fiemap->fm_extents[0].fe_flags & ctrl.exclude_flags) {
-            INFO(2,
-                 "FILE %s\nExtent Reported on %s  PBAS: "
-                 "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
-                 filename, ctrl.bdev.dev_name,
-                 fiemap->fm_extents[0].fe_physical >> ctrl.sector_shift,
-                 (fiemap->fm_extents[0].fe_physical +
-                  fiemap->fm_extents[0].fe_length) >>
-                     ctrl.sector_shift,
-                 fiemap->fm_extents[0].fe_length >> ctrl.sector_shift);
-
-            if (ctrl.log_level > 1) {
-                show_extent_flags(fiemap->fm_extents[0].fe_flags);
-                MSG("Disregarding extent because exclude flag is set to:\n");
-                show_extent_flags(ctrl.exclude_flags);
+        if (buf->nr_extents + nr_extents > buf->cap) {
+            while (buf->nr_extents + nr_extents > buf->cap) {
+                buf->cap = buf->cap == 0 ? FIEMAP_EXTENT_BATCH : buf->cap << 1;
             }
-        } else {
-            extent->phy_blk =
-                (fiemap->fm_extents[0].fe_physical - ctrl.offset) >>
-                ctrl.sector_shift;
-            extent->logical_blk =
-                fiemap->fm_extents[0].fe_logical >> ctrl.sector_shift;
-            extent->len = fiemap->fm_extents[0].fe_length >> ctrl.sector_shift;
-            extent->zone_size = ctrl.znsdev.zone_size;
-            extent->ext_nr = ext_ctr; /* individual extent counter for each
-                                         get_extents() scope -> each file */
-            extent->flags = fiemap->fm_extents[0].fe_flags;
-
-            ctrl.zonemap->cum_extent_size += extent->len;
-
-            extent->zone =
-                get_zone_number((extent->phy_blk << ctrl.zns_sector_shift));
-
-            strncpy(extent->file, filename, sizeof(extent->file) - 1);
-            extent->file[sizeof(extent->file) - 1] = '\0';
-
-            get_zone_info(extent);
-            extent->fileID = ctrl.nr_files;
-
-            if (ctrl.fs_info_bytes > 0) {
-                /* only init if file system has fs_info setup */
-                extent->fs_info = calloc(1, ctrl.fs_info_bytes);
-
-                /* must init the fs_info before adding extent to the zone list,
-                 * it does a memcpy() */
-                ctrl.fs_info_init(ctrl.fs_manager, extent->fs_info,
-                                  (extent->phy_blk & ctrl.f2fs_segment_mask) >>
-                                      ctrl.segment_shift);
-                add_extent_to_zone_list(*extent);
-
-                /* free extent fs_info as it has been memcpy() */
-                free(extent->fs_info);
-            } else {
-                add_extent_to_zone_list(*extent);
+
+            temp = realloc(buf->extents,
+                           sizeof(struct fiemap_extent) * buf->cap);
+            if (temp == NULL) {
+                ERR_MSG("Failed memory allocation\n");
+                free(fiemap);
+                return EXIT_FAILURE;
             }
+            buf->extents = temp;
+        }
 
-            increase_file_extent_counter(extent->file);
+        for (uint32_t i = 0; i < nr_extents; i++) {
+            fe = &fiemap->fm_extents[i];
+            fe->fe_reserved[FIEMAP_EXT_NR] = buf->file_ext_ctr;
 
-            /* clear extent memory for the next extent */
-            memset(extent, 0, sizeof(struct extent));
+            if (is_numbered_extent(fe)) {
+                buf->file_ext_ctr++;
 
-            ext_ctr++;
-            ctrl.zonemap->extent_ctr++;
-            ctrl.zonemap->zone_ctr++;
-        }
+                if (ctrl.zone_range_only &&
+                    !(fe->fe_flags & FIEMAP_EXTENT_DATA_INLINE) &&
+                    !in_zone_range((fe->fe_physical - ctrl.offset) >>
+                                   ctrl.sector_shift)) {
+                    buf->range_extent_ctr++;
+                    continue;
+                }
+            }
 
-        if (fiemap->fm_extents[0].fe_flags & FIEMAP_EXTENT_DATA_INLINE) {
-            ctrl.inlined_extent_ctr++;
+            buf->extents[buf->nr_extents++] = *fe;
         }
 
-        if (fiemap->fm_extents[0].fe_flags & FIEMAP_EXTENT_LAST) {
+        fe = &fiemap->fm_extents[nr_extents - 1];
+        if (fe->fe_flags & FIEMAP_EXTENT_LAST) {
             last_ext = 1;
         }
 
-        fiemap->fm_start = ((fiemap->fm_extents[0].fe_logical) +
-                            (fiemap->fm_extents[0].fe_length));
-
+        /* continue after the last extent of this batch, the file is already
+         * synced from the first call */
+        fiemap->fm_start = fe->fe_logical + fe->fe_length;
+        fiemap->fm_flags = 0;
     } while (last_ext == 0);
 
-    ctrl.nr_files++;
-
     free(fiemap);
     fiemap = NULL;
 
     return EXIT_SUCCESS;
 }
 
+/*
+ * Map the retrieved extents of a file into the zonemap, and create the
+ * file_counter_map entry of the file. Must not be called concurrently.
+ *
+ * @filename: char * to the file name (full path)
+ * @extents: struct fiemap_extent * array of the extents of the file
+ * @nr_extents: number of extents in the array
+ * @ext_ctr: number of extents of the file, including the extents that
+ * retrieve_extents() dropped
+ *
+ * returns: EXIT_SUCCESS on success, EXIT_FAILURE on failure
+ *
+ * */
+int map_file_extents(char *filename, struct fiemap_extent *extents,
+                     uint32_t nr_extents, uint32_t ext_ctr) {
+    uint32_t mapped_ctr = 0;
+    int ret = EXIT_SUCCESS, mapped;
+
+    /* grow the file_counter_map here as this function is always called for a
+     * single file, which needs at most one new entry */
+    if (ctrl.file_counter_map == NULL) {
+        ret = reserve_file_counter_map(FILE_COUNTER_MIN_ENTRIES);
+    } else if (ctrl.file_counter_map->file_ctr ==
+               ctrl.file_counter_map->file_cap) {
+        ret = reserve_file_counter_map(ctrl.file_counter_map->file_cap << 1);
+    }
+
+    if (ret == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < nr_extents; i++) {
+        /* extents outside of the zone range keep their number, such that the
+         * extent numbers of the file do not depend on the range */
+        mapped = map_fiemap_extent(filename, &extents[i],
+                                   extents[i].fe_reserved[FIEMAP_EXT_NR],
+                                   mapped_ctr == 0);
+        mapped_ctr += mapped > 0;
+
+        if (extents[i].fe_flags & FIEMAP_EXTENT_DATA_INLINE) {
+            ctrl.inlined_extent_ctr++;
+        }
+
+        if (extents[i].fe_flags & FIEMAP_EXTENT_DELALLOC) {
+            ctrl.delalloc_extent_ctr++;
+        }
+    }
+
+    if (mapped_ctr > 0) {
+        ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr - 1]
+            .ext_ctr = ext_ctr;
+    }
+
+    ctrl.nr_files++;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Retrieve all extents of a file with FIEMAP and add them to the zonemap.
+ *
+ * @filename: char * to the file name (full path)
+ * @fd: open file descriptor of the file
+ *
+ * returns: EXIT_SUCCESS on success, EXIT_FAILURE on failure
+ *
+ * */
+int get_extents(char *filename, int fd) {
+    struct fiemap_buffer buf = {0};
+    int ret;
+
+    ret = retrieve_extents(fd, &buf);
+    if (ret == EXIT_SUCCESS) {
+        ret = map_file_extents(filename, buf.extents, buf.nr_extents,
+                               buf.file_ext_ctr);
+        ctrl.range_extent_ctr += buf.range_extent_ctr;
+    }
+
+    free(buf.extents);
+
+    return ret;
+}
+
 /*
  * Check if an element is contained in the array.
  *
@@ -735,60 +1030,54 @@ int contains_element(uint32_t list[], uint32_t element, uint32_t size) {
 /*
  * Get the total number of extents for a particular file.
  *
- * @file: char * to the file name (full path)
+ * @fileID: uint32_t ID of the file (index in the file_counter_map)
  *
  * returns: uint32_t counter of extents for the file
  *
  * */
-uint32_t get_file_extent_count(char *file) {
-    for (uint32_t i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strlen(ctrl.file_counter_map->files[i].file) == strlen(file) &&
-            strncmp(ctrl.file_counter_map->files[i].file, file,
-                    strlen(ctrl.file_counter_map->files[i].file)) == 0) {
-            return ctrl.file_counter_map->files[i].ext_ctr;
-        }
-    }
+uint32_t get_file_extent_count(uint32_t fileID) {
+    return ctrl.file_counter_map->files[fileID].ext_ctr;
+}
 
-    return 0;
+/*
+ * Get the file name of a particular file.
+ *
+ * @fileID: uint32_t ID of the file (index in the file_counter_map)
+ *
+ * returns: char * to the file name (full path)
+ *
+ * */
+char *get_file_name(uint32_t fileID) {
+    return ctrl.file_counter_map->files[fileID].file;
 }
 
 /*
  * TODO: move this to libf2fs, since it is only f2fs
  * Increase the segment counts for a particular file
  *
- * @file: char * to file name (full path)
+ * @fileID: uint32_t ID of the file (index in the file_counter_map)
  *
  * */
-void increase_file_segment_counter(char *file, unsigned int num_segments,
+void increase_file_segment_counter(uint32_t fileID, unsigned int num_segments,
                                    unsigned int cur_segment, void *fs_info,
                                    uint64_t zone_cap) {
-    uint32_t i;
-
+    struct file_counter *counter = &ctrl.file_counter_map->files[fileID];
     struct segment_info *seg_i = (struct segment_info *)fs_info;
     enum type type = seg_i->type;
 
-    for (i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strlen(ctrl.file_counter_map->files[i].file) == strlen(file) &&
-            strncmp(ctrl.file_counter_map->files[i].file, file,
-                    strlen(ctrl.file_counter_map->files[i].file)) == 0) {
-            goto found;
-        }
-    }
-
-found:
-    if (ctrl.file_counter_map->files[i].last_segment_id != cur_segment) {
-        ctrl.file_counter_map->files[i].segment_ctr += num_segments;
-        ctrl.file_counter_map->files[i].last_segment_id = cur_segment;
+    if (counter->last_segment_id != cur_segment) {
+        counter->segment_ctr += num_segments;
+        counter->last_segment_id = cur_segment;
 
         switch (type) {
         case CURSEG_COLD_DATA:
-            ctrl.file_counter_map->files[i].cold_ctr += num_segments;
+            counter->cold_ctr += num_segments;
             break;
         case CURSEG_WARM_DATA:
-            ctrl.file_counter_map->files[i].warm_ctr += num_segments;
+            counter->warm_ctr += num_segments;
             break;
         case CURSEG_HOT_DATA:
-            ctrl.file_counter_map->files[i].hot_ctr += num_segments;
+            counter->hot_ctr += num_segments;
             break;
         default:
             break;
@@ -797,12 +1086,12 @@ found:
 
     uint32_t zone = get_zone_number(cur_segment << ctrl.segment_shift >>
                                     ctrl.zns_sector_shift);
-    if (ctrl.file_counter_map->files[i].last_zone != zone) {
-        ctrl.file_counter_map->files[i].zone_ctr +=
+    if (counter->last_zone != zone) {
+        counter->zone_ctr +=
             (num_segments * F2FS_SEGMENT_BYTES >> ctrl.sector_shift) /
                 zone_cap +
             1;
-        ctrl.file_counter_map->files[i].last_zone = zone;
+        counter->last_zone = zone;
     }
 }
 
@@ -918,6 +1207,27 @@ void init_ctrl(char *filename, int fd, struct stat *stats) {
     }
 }
 
+/*
+ * Print a hole between extents, or between an extent and its zone
+ *
+ * @label: start of the line, identifying the hole
+ * @pbas: first sector of the hole
+ * @pbae: end sector of the hole
+ * @size: number of sectors of the hole
+ *
+ * */
+static void print_hole(const char *label, uint64_t pbas, uint64_t pbae,
+                       uint64_t size) {
+    struct rep_line line = {0};
+
+    HOLE_FORMATTER;
+    rep_add_str(&line, label);
+    rep_add_range(&line, pbas, pbae, size);
+    rep_add_str(&line, "\n");
+    rep_write(&line);
+    HOLE_FORMATTER;
+}
+
 /*
  * Print the report summary of all the extents in the zonemap.
  * This is used by zns.fiemap and by zns.segmap (for file systems
@@ -926,13 +1236,18 @@ void init_ctrl(char *filename, int fd, struct stat *stats) {
  *
  * */
 void print_fiemap_report() {
+    struct rep_line line = {0};
     uint32_t i = 0;
     uint32_t hole_ctr = 0;
     uint64_t hole_cum_size = 0;
     uint64_t hole_size = 0;
     uint64_t hole_end = 0;
     uint64_t pbae = 0;
-    struct node *current, *prev = NULL;
+    struct extent *current, *prev = NULL;
+    struct zone *zone;
+
+    update_zone_map();
+    sort_zone_map();
 
     MSG("================================================================="
         "===\n");
@@ -941,94 +1256,79 @@ void print_fiemap_report() {
         "=\n");
 
     for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        if (ctrl.zonemap->zones[i].extent_ctr == 0) {
+        zone = &ctrl.zonemap->zones[i];
+        if (zone->extent_ctr == 0) {
             continue;
         }
 
         print_zone_info(i);
         MSG("\n");
 
-        current = ctrl.zonemap->zones[i].extents_head;
+        for (uint32_t j = 0; j < zone->extent_ctr; j++) {
+            current = zone->extents[j];
 
-        while (current) {
             /* Track holes in between extents in the same zone */
             if (ctrl.show_holes && prev != NULL &&
-                (prev->extent->phy_blk + prev->extent->len !=
-                 current->extent->phy_blk)) {
-                if (prev->extent->zone == current->extent->zone) {
-                    hole_size = current->extent->phy_blk -
-                                (prev->extent->phy_blk + prev->extent->len);
+                (prev->phy_blk + prev->len != current->phy_blk)) {
+                if (prev->zone == current->zone) {
+                    hole_size = current->phy_blk - (prev->phy_blk + prev->len);
                     hole_cum_size += hole_size;
                     hole_ctr++;
 
-                    HOLE_FORMATTER;
-                    MSG("--- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                        "  SIZE: %#-10" PRIx64 "\n",
-                        prev->extent->phy_blk + prev->extent->len,
-                        current->extent->phy_blk, hole_size);
-                    HOLE_FORMATTER;
+                    print_hole("--- HOLE:  ", prev->phy_blk + prev->len,
+                               current->phy_blk, hole_size);
                 }
             }
             /* Hole between LBAS of zone and PBAS of the extent */
-            if (ctrl.show_holes && current->next != NULL && prev != NULL &&
-                current->extent->zone_lbas != current->extent->phy_blk &&
-                prev->extent->zone != current->extent->zone) {
+            if (ctrl.show_holes && j + 1 < zone->extent_ctr && prev != NULL &&
+                zone->start != current->phy_blk &&
+                prev->zone != current->zone) {
 
-                hole_size =
-                    current->extent->phy_blk - current->extent->zone_lbas;
+                hole_size = current->phy_blk - zone->start;
                 hole_cum_size += hole_size;
                 hole_ctr++;
 
-                HOLE_FORMATTER;
-                MSG("---- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "\n",
-                    current->extent->zone_lbas, current->extent->phy_blk,
-                    hole_size);
-                HOLE_FORMATTER;
+                print_hole("---- HOLE:  ", zone->start, current->phy_blk,
+                           hole_size);
             }
 
-            MSG("EXTID: %-4d  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                "  SIZE: %#-10" PRIx64 "\n",
-                current->extent->ext_nr + 1, current->extent->phy_blk,
-                (current->extent->phy_blk + current->extent->len),
-                current->extent->len);
+            rep_add_str(&line, "EXTID: ");
+            rep_add_uint(&line, current->ext_nr + 1, 4);
+            rep_add_range(&line, current->phy_blk,
+                          current->phy_blk + current->len, current->len);
+            rep_add_str(&line, "\n");
+            rep_write(&line);
 
-            if (current->extent->flags != 0 && ctrl.show_flags) {
-                show_extent_flags(current->extent->flags);
+            if (current->flags != 0 && ctrl.show_flags) {
+                show_extent_flags(current->flags);
             }
 
             /* Hole between PBAE of the extent and the zone LBAE (since WP can
              * be next zone LBAS if full) e.g. extent ends before the write
              * pointer of its zone but the next extent is in a different zone
              * (hence hole between PBAE and WP) */
-            pbae = current->extent->phy_blk + current->extent->len;
+            pbae = current->phy_blk + current->len;
             // TODO: only show hole after extents if  there is another extent
             // (need to track extents per file to know this value) - add once
             // file tracking is implemented
-            if (ctrl.show_holes && current->next == NULL &&
-                pbae != current->extent->zone_lbae &&
-                current->extent->zone_wp > pbae) {
+            if (ctrl.show_holes && j + 1 == zone->extent_ctr &&
+                pbae != zone->end && zone->wp > pbae) {
 
-                if (current->extent->zone_wp < current->extent->zone_lbae) {
-                    hole_end = current->extent->zone_wp;
+                if (zone->wp < zone->end) {
+                    hole_end = zone->wp;
                 } else {
-                    hole_end = current->extent->zone_lbae;
+                    hole_end = zone->end;
                 }
 
                 hole_size = hole_end - pbae;
                 hole_cum_size += hole_size;
                 hole_ctr++;
 
-                HOLE_FORMATTER;
-                MSG("--- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "\n",
-                    current->extent->phy_blk + current->extent->len, hole_end,
-                    hole_size);
-                HOLE_FORMATTER;
+                print_hole("--- HOLE:  ", current->phy_blk + current->len,
+                           hole_end, hole_size);
             }
 
             prev = current;
-            current = current->next;
         }
     }
 
@@ -1053,4 +1353,8 @@ void print_fiemap_report() {
     } else if (ctrl.show_holes && hole_ctr == 0) {
         MSG("NOH: 0\n");
     }
+
+    if (ctrl.delalloc_extent_ctr > 0) {
+        MSG("NOD: %-4lu\n", ctrl.delalloc_extent_ctr);
+    }
 }
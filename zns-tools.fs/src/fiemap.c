@@ -43,6 +43,8 @@ static void show_info() {
         "512B sectors)\n");
     MSG("EAHS:   Exact Average Hole Size (double point precision value, "
         "in 512B sectors\n");
+    MSG("NOD:    Number of Delayed allocation extents (not yet written, only "
+        "with -u)\n");
 }
 
 /*
@@ -59,6 +61,9 @@ static void show_help() {
     MSG("-s\t\tShow file holes\n");
     MSG("-l [Int]\tLog Level to print\n");
     MSG("-s\t\tShow file holes\n");
+    MSG("-u\t\tDon't sync the file before mapping it\n");
+    MSG("-b [file]\tWrite the zone map as binary snapshot to file\n");
+    MSG("-x [file]\tWrite the extents of the zone map as csv to file\n");
 
     show_info();
     exit(0);
@@ -72,8 +77,10 @@ int main(int argc, char *argv[]) {
     int fd = 0;
 
     memset(&ctrl, 0, sizeof(struct control));
+    ctrl.argv = argv[0];
+    rep_init();
 
-    while ((c = getopt(argc, argv, "f:hil:sw")) != -1) {
+    while ((c = getopt(argc, argv, "f:hil:swub:x:")) != -1) {
         switch (c) {
         case 'h':
             show_help();
@@ -91,6 +98,15 @@ int main(int argc, char *argv[]) {
         case 's':
             ctrl.show_holes = 1;
             break;
+        case 'u':
+            ctrl.no_sync = 1;
+            break;
+        case 'b':
+            ctrl.snap_file = optarg;
+            break;
+        case 'x':
+            ctrl.csv_file = optarg;
+            break;
         default:
             show_help();
             abort();
@@ -108,7 +124,9 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    fsync(fd);
+    if (!ctrl.no_sync) {
+        fsync(fd);
+    }
 
     stats = calloc(1, sizeof(struct stat));
     if (fstat(fd, stats) < 0) {
@@ -117,7 +135,7 @@ int main(int argc, char *argv[]) {
 
     init_ctrl(filename, fd, stats);
 
-    ret = get_extents(filename, fd, stats);
+    ret = get_extents(filename, fd);
 
     if (ret == EXIT_FAILURE) {
         ERR_MSG("retrieving extents for %s\n", filename);
@@ -127,7 +145,17 @@ int main(int argc, char *argv[]) {
 
     close(fd);
 
-    print_fiemap_report();
+    if (ctrl.snap_file || ctrl.csv_file) {
+        update_zone_map();
+        sort_zone_map();
+
+        if (ctrl.snap_file)
+            snap_write(ctrl.snap_file);
+        if (ctrl.csv_file)
+            csv_dump_data(ctrl.csv_file);
+    } else {
+        print_fiemap_report();
+    }
 
     cleanup_ctrl();
     free(stats);
@@ -1,7 +1,9 @@
 #ifndef _FIEMAP_H_
 #define _FIEMAP_H_
 
+#include "csv.h"
 #include "json.h"
+#include "snapshot.h"
 #include "zns-tools.h"
 
 #endif
@@ -1,5 +1,10 @@
 #include "imap.h"
 
+static struct imap_manager imap_man;
+
+static const char *imap_node_type_str[] = {"INODE", "DIRECT", "INDIRECT",
+                                           "DINDIRECT", "XATTR"};
+
 /*
  *
  * Show the command help.
@@ -8,28 +13,461 @@
  * */
 static void show_help() {
     MSG("Possible flags are:\n");
-    MSG("-f [file]\tInput file retrieve inode for [Required]\n");
+    MSG("-f [file]\tInput file retrieve inode for, can be given multiple "
+        "times [Required, or -d]\n");
+    MSG("-d [dir]\tMap the node blocks of all files in dir and below\n");
     MSG("-l [Int, 0-2]\tLog Level to print (Default 0)\n");
     MSG("-s \t\tShow the superblock\n");
     MSG("-c \t\tShow the checkpoint\n");
+    MSG("-q [uint]\tNumber of node block reads in flight in batch mode "
+        "(Default %u)\n",
+        F2FS_READ_QUEUE_DEPTH);
+
+    MSG("\nGiving more than one file or a directory maps all node blocks of "
+        "the files\nin a single pass over the NAT and prints one line per "
+        "node block.\n");
 
     exit(0);
 }
 
+/*
+ * Add a file to the files to map in batch mode.
+ *
+ * @filename: path of the file
+ * @ino: inode number of the file
+ *
+ * */
+static void add_file(char *filename, uint64_t ino) {
+    if (imap_man.nr_files == imap_man.files_cap) {
+        imap_man.files_cap = imap_man.files_cap ? imap_man.files_cap * 2
+                                                : IMAP_MIN_ENTRIES;
+        imap_man.files =
+            realloc(imap_man.files,
+                    sizeof(struct imap_file) * imap_man.files_cap);
+        if (!imap_man.files) {
+            ERR_MSG("allocating the file list\n");
+        }
+    }
+
+    imap_man.files[imap_man.nr_files].filename = strdup(filename);
+    imap_man.files[imap_man.nr_files].ino = ino;
+    imap_man.nr_files++;
+}
+
+/*
+ * Recursively add all regular files in a directory to the batch.
+ *
+ * @dir: path of the directory
+ *
+ * */
+static void add_dir(char *dir) {
+    DIR *d;
+    struct dirent *dirent;
+    struct stat stats;
+    char path[MAX_PATH_LEN];
+
+    d = opendir(dir);
+    if (!d) {
+        WARN("Failed opening directory %s\n", dir);
+        return;
+    }
+
+    while ((dirent = readdir(d)) != NULL) {
+        if (strcmp(dirent->d_name, ".") == 0 ||
+            strcmp(dirent->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (snprintf(path, MAX_PATH_LEN, "%s/%s", dir, dirent->d_name) >=
+            MAX_PATH_LEN) {
+            WARN("Path of %s in %s is too long, skipping\n", dirent->d_name,
+                 dir);
+            continue;
+        }
+
+        if (lstat(path, &stats) < 0) {
+            WARN("Failed stat on %s\n", path);
+            continue;
+        }
+
+        if (S_ISDIR(stats.st_mode)) {
+            add_dir(path);
+        } else if (S_ISREG(stats.st_mode)) {
+            add_file(path, stats.st_ino);
+        }
+    }
+
+    closedir(d);
+}
+
+/*
+ * Look up a node in the NAT and add it to the resolved nodes.
+ *
+ * @nat: the loaded NAT
+ * @file: index of the owning file
+ * @nid: node id to add
+ * @type: enum imap_node_type of the node
+ *
+ * */
+static void add_node(struct f2fs_nat_index *nat, uint32_t file, uint32_t nid,
+                     uint32_t type) {
+    struct f2fs_nat_entry *nat_entry = NULL;
+
+    nat_entry = f2fs_get_nat_entry(nat, nid);
+    if (!nat_entry) {
+        INFO(1, "No NAT entry for nid %u of %s\n", nid,
+             imap_man.files[file].filename);
+        return;
+    }
+
+    if (imap_man.nr_nodes == imap_man.nodes_cap) {
+        imap_man.nodes_cap = imap_man.nodes_cap ? imap_man.nodes_cap * 2
+                                                : IMAP_MIN_ENTRIES;
+        imap_man.nodes =
+            realloc(imap_man.nodes,
+                    sizeof(struct imap_node) * imap_man.nodes_cap);
+        if (!imap_man.nodes) {
+            ERR_MSG("allocating the node list\n");
+        }
+    }
+
+    imap_man.nodes[imap_man.nr_nodes].file = file;
+    imap_man.nodes[imap_man.nr_nodes].nid = nid;
+    imap_man.nodes[imap_man.nr_nodes].blk_addr = nat_entry->block_addr;
+    imap_man.nodes[imap_man.nr_nodes].type = type;
+    imap_man.nr_nodes++;
+}
+
+/*
+ * Get the number of node blocks in the read order, starting at an index,
+ * that are adjacent on the same device and can be read at once.
+ *
+ * @order: uint64_t * to the node indices sorted by address
+ * @start: index in order of the first node
+ * @nr_reads: number of nodes in order
+ *
+ * returns: number of adjacent node blocks, at most IMAP_READ_BLOCKS
+ *
+ * */
+static uint32_t get_adjacent_nodes(uint64_t *order, uint64_t start,
+                                   uint64_t nr_reads) {
+    uint32_t blk_addr = imap_man.nodes[order[start]].blk_addr;
+    uint32_t zns_blkaddr = ctrl.offset >> F2FS_BLKSIZE_BITS;
+    uint32_t nr = 1;
+
+    while (start + nr < nr_reads && nr < IMAP_READ_BLOCKS &&
+           imap_man.nodes[order[start + nr]].blk_addr == blk_addr + nr &&
+           blk_addr + nr != zns_blkaddr) {
+        nr++;
+    }
+
+    return nr;
+}
+
+/*
+ * Prepare a batch of reads for the node blocks in the read order, starting
+ * at an index. Adjacent node blocks are read with a single read.
+ *
+ * @order: uint64_t * to the node indices sorted by address
+ * @start: index in order of the first node of the batch
+ * @nr_reads: number of nodes in order
+ * @nodes: struct f2fs_node * buffer for IMAP_BATCH_BLOCKS node blocks
+ * @reqs: struct f2fs_read_req * array for IMAP_BATCH_BLOCKS reads
+ * @nr_reqs: set to the number of reads of the batch
+ *
+ * returns: number of node blocks in the batch
+ *
+ * */
+static uint32_t prepare_node_reads(uint64_t *order, uint64_t start,
+                                   uint64_t nr_reads, struct f2fs_node *nodes,
+                                   struct f2fs_read_req *reqs,
+                                   uint32_t *nr_reqs) {
+    struct f2fs_read_req *req;
+    uint32_t nr_blocks, blk = 0;
+    uint64_t addr;
+
+    *nr_reqs = 0;
+    while (start + blk < nr_reads && blk < IMAP_BATCH_BLOCKS) {
+        nr_blocks = get_adjacent_nodes(order, start + blk, nr_reads);
+        if (blk + nr_blocks > IMAP_BATCH_BLOCKS) {
+            nr_blocks = IMAP_BATCH_BLOCKS - blk;
+        }
+
+        addr = (uint64_t)imap_man.nodes[order[start + blk]].blk_addr
+               << F2FS_BLKSIZE_BITS;
+
+        req = &reqs[(*nr_reqs)++];
+        if (addr < ctrl.offset) {
+            req->dev_path = ctrl.bdev.dev_path;
+        } else {
+            req->dev_path = ctrl.znsdev.dev_path;
+            addr -= ctrl.offset;
+        }
+        req->offset = addr;
+        req->size = sizeof(struct f2fs_node) * nr_blocks;
+        req->dest = &nodes[blk];
+
+        blk += nr_blocks;
+    }
+
+    return blk;
+}
+
+static int cmp_node_addr(const void *a, const void *b) {
+    uint32_t addr_a = imap_man.nodes[*(uint64_t *)a].blk_addr;
+    uint32_t addr_b = imap_man.nodes[*(uint64_t *)b].blk_addr;
+
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+static int cmp_node_file(const void *a, const void *b) {
+    const struct imap_node *node_a = a;
+    const struct imap_node *node_b = b;
+
+    if (node_a->file != node_b->file) {
+        return (node_a->file > node_b->file) - (node_a->file < node_b->file);
+    }
+    if (node_a->type != node_b->type) {
+        return (node_a->type > node_b->type) - (node_a->type < node_b->type);
+    }
+
+    return (node_a->blk_addr > node_b->blk_addr) -
+           (node_a->blk_addr < node_b->blk_addr);
+}
+
+/*
+ * Add the child nodes referenced by a node block that was read.
+ *
+ * @nat: the loaded NAT
+ * @parent: copy of the node that was read
+ * @node: the contents of the node block
+ *
+ * */
+static void add_child_nodes(struct f2fs_nat_index *nat,
+                            struct imap_node *parent,
+                            struct f2fs_node *node) {
+    uint32_t i;
+
+    if (node->footer.nid != parent->nid) {
+        WARN("Node block %#x holds nid %u instead of nid %u of %s\n",
+             parent->blk_addr, node->footer.nid, parent->nid,
+             imap_man.files[parent->file].filename);
+        return;
+    }
+
+    switch (parent->type) {
+    case IMAP_INODE:
+        if (!IS_INODE(node)) {
+            WARN("Node block of %s with inode %u is not an inode\n",
+                 imap_man.files[parent->file].filename, parent->nid);
+            return;
+        }
+        if (node->i.i_xattr_nid) {
+            add_node(nat, parent->file, node->i.i_xattr_nid, IMAP_XATTR);
+        }
+        for (i = 0; i < 5; i++) {
+            if (!node->i.i_nid[i]) {
+                continue;
+            }
+            /* i_nid holds 2 direct, 2 indirect, and 1 double indirect */
+            add_node(nat, parent->file, node->i.i_nid[i],
+                     i < 2 ? IMAP_DIRECT
+                           : (i < 4 ? IMAP_INDIRECT : IMAP_DINDIRECT));
+        }
+        break;
+    case IMAP_INDIRECT:
+    case IMAP_DINDIRECT:
+        for (i = 0; i < NIDS_PER_BLOCK; i++) {
+            if (!node->in.nid[i]) {
+                continue;
+            }
+            add_node(nat, parent->file, node->in.nid[i],
+                     parent->type == IMAP_INDIRECT ? IMAP_DIRECT
+                                                   : IMAP_INDIRECT);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Resolve the node blocks of all files in the batch. Nodes are resolved in
+ * rounds, one per level of the node tree, and the node blocks of each round
+ * are read in order of their address, with adjacent node blocks read at
+ * once. The reads of a round are issued in batches, with queue_depth reads
+ * in flight. Direct and xattr nodes only need their NAT entry and are never
+ * read.
+ *
+ * @nat: the loaded NAT
+ *
+ * */
+static void resolve_nodes(struct f2fs_nat_index *nat) {
+    struct f2fs_node *nodes = NULL;
+    struct f2fs_read_req *reqs = NULL;
+    struct imap_node parent;
+    uint64_t *order = NULL;
+    uint64_t round_start = 0, round_end = 0, nr_reads = 0;
+    uint64_t i;
+    uint32_t nr_batch, nr_reqs, nr_blocks, blk;
+
+    for (i = 0; i < imap_man.nr_files; i++) {
+        /* the nid of an inode is its inode number */
+        add_node(nat, i, imap_man.files[i].ino, IMAP_INODE);
+    }
+
+    nodes = f2fs_alloc_io_buf(sizeof(struct f2fs_node) * IMAP_BATCH_BLOCKS);
+    reqs = calloc(IMAP_BATCH_BLOCKS, sizeof(struct f2fs_read_req));
+    if (!reqs) {
+        ERR_MSG("allocating the node reads\n");
+    }
+
+    while (round_start < imap_man.nr_nodes) {
+        round_end = imap_man.nr_nodes;
+        nr_reads = 0;
+
+        order = realloc(order, sizeof(uint64_t) * (round_end - round_start));
+        if (!order) {
+            ERR_MSG("allocating the node read order\n");
+        }
+
+        for (i = round_start; i < round_end; i++) {
+            if (imap_man.nodes[i].type == IMAP_INODE ||
+                imap_man.nodes[i].type == IMAP_INDIRECT ||
+                imap_man.nodes[i].type == IMAP_DINDIRECT) {
+                order[nr_reads++] = i;
+            }
+        }
+
+        qsort(order, nr_reads, sizeof(uint64_t), cmp_node_addr);
+
+        for (i = 0; i < nr_reads; i += nr_batch) {
+            nr_batch =
+                prepare_node_reads(order, i, nr_reads, nodes, reqs, &nr_reqs);
+            f2fs_read_dev_batch(reqs, nr_reqs, imap_man.queue_depth);
+
+            blk = 0;
+            for (uint32_t r = 0; r < nr_reqs; r++) {
+                nr_blocks = reqs[r].size / sizeof(struct f2fs_node);
+                if (!reqs[r].done) {
+                    WARN("Failed reading %u node blocks at %#x\n", nr_blocks,
+                         imap_man.nodes[order[i + blk]].blk_addr);
+                    blk += nr_blocks;
+                    continue;
+                }
+
+                for (uint32_t b = 0; b < nr_blocks; b++, blk++) {
+                    /* add_node() can move the array, work on a copy */
+                    parent = imap_man.nodes[order[i + blk]];
+                    add_child_nodes(nat, &parent, &nodes[blk]);
+                }
+            }
+        }
+
+        INFO(1, "Read %lu node blocks, found %lu new nodes\n", nr_reads,
+             imap_man.nr_nodes - round_end);
+
+        round_start = round_end;
+    }
+
+    free(order);
+    free(nodes);
+    free(reqs);
+}
+
+/*
+ * Print the resolved node blocks, one line per node block. Locations use the
+ * same zone, segment, and sector numbering as zns.segmap.
+ *
+ * */
+static void print_nodes() {
+    struct imap_node *node = NULL;
+    uint64_t addr, pbas;
+    uint64_t i;
+
+    qsort(imap_man.nodes, imap_man.nr_nodes, sizeof(struct imap_node),
+          cmp_node_file);
+
+    MSG("FILE,INO,NID,TYPE,DEV,ZONE,SEGMENT,PBAS,PBAE\n");
+
+    for (i = 0; i < imap_man.nr_nodes; i++) {
+        node = &imap_man.nodes[i];
+        addr = (uint64_t)node->blk_addr << F2FS_BLKSIZE_BITS;
+
+        if (addr < ctrl.offset) {
+            pbas = addr >> ctrl.sector_shift;
+            MSG("%s,%lu,%u,%s,%s,-,%lu,%#" PRIx64 ",%#" PRIx64 "\n",
+                imap_man.files[node->file].filename,
+                imap_man.files[node->file].ino, node->nid,
+                imap_node_type_str[node->type], ctrl.bdev.dev_name,
+                (pbas & ctrl.f2fs_segment_mask) >> ctrl.segment_shift, pbas,
+                pbas + (BLOCK_SZ >> ctrl.sector_shift));
+        } else {
+            pbas = (addr - ctrl.offset) >> ctrl.sector_shift;
+            MSG("%s,%lu,%u,%s,%s,%u,%lu,%#" PRIx64 ",%#" PRIx64 "\n",
+                imap_man.files[node->file].filename,
+                imap_man.files[node->file].ino, node->nid,
+                imap_node_type_str[node->type], ctrl.znsdev.dev_name,
+                get_zone_number(pbas << ctrl.zns_sector_shift),
+                (pbas & ctrl.f2fs_segment_mask) >> ctrl.segment_shift, pbas,
+                pbas + (BLOCK_SZ >> ctrl.sector_shift));
+        }
+    }
+}
+
+/*
+ * Map the node blocks of all files in the batch with a single load of the
+ * NAT.
+ *
+ * */
+static void map_batch() {
+    struct f2fs_nat_index *nat = NULL;
+    uint32_t i;
+
+    if (!imap_man.nr_files) {
+        ERR_MSG("No files to map\n");
+    }
+
+    nat = f2fs_load_nat_index(ctrl.bdev.dev_path);
+
+    resolve_nodes(nat);
+    print_nodes();
+
+    for (i = 0; i < imap_man.nr_files; i++) {
+        free(imap_man.files[i].filename);
+    }
+    free(imap_man.files);
+    free(imap_man.nodes);
+    free(nat);
+}
+
 int main(int argc, char *argv[]) {
     struct stat *stats;
-    char *filename;
+    char *filename = NULL;
+    char *dir = NULL;
     int fd = 0;
     int c;
     uint8_t set_file = 0;
+    uint8_t batch = 0;
+    struct f2fs_nat_index *nat = NULL;
     struct f2fs_nat_entry *nat_entry = NULL;
     struct f2fs_node *node_block = NULL;
     struct f2fs_inode *inode = NULL;
+    struct stat file_stats;
 
-    while ((c = getopt(argc, argv, "cf:hl:s")) != -1) {
+    while ((c = getopt(argc, argv, "cd:f:hl:q:s")) != -1) {
         switch (c) {
+        case 'd':
+            dir = optarg;
+            break;
         case 'f':
-            filename = optarg;
+            if (set_file) {
+                batch = 1;
+            }
+            if (stat(optarg, &file_stats) < 0) {
+                ERR_MSG("Failed stat on file %s\n", optarg);
+            }
+            add_file(optarg, file_stats.st_ino);
             set_file = 1;
             break;
         case 'h':
@@ -44,14 +482,28 @@ int main(int argc, char *argv[]) {
         case 'c':
             ctrl.show_checkpoint = 1;
             break;
+        case 'q':
+            imap_man.queue_depth = atoi(optarg);
+            break;
         default:
             show_help();
             abort();
         }
     }
 
-    if (!set_file) {
-        ERR_MSG("Missing file name -f Flag.\n");
+    if (!set_file && !dir) {
+        ERR_MSG("Missing file name -f Flag or directory -d Flag.\n");
+    }
+
+    if (imap_man.queue_depth == 0) {
+        imap_man.queue_depth = F2FS_READ_QUEUE_DEPTH;
+    }
+
+    if (dir) {
+        batch = 1;
+        filename = dir;
+    } else {
+        filename = imap_man.files[0].filename;
     }
 
     fd = open(filename, O_RDONLY);
@@ -85,31 +537,41 @@ int main(int argc, char *argv[]) {
         f2fs_show_checkpoint();
     }
 
+    if (batch) {
+        if (dir) {
+            add_dir(dir);
+        }
+        map_batch();
+
+        cleanup_ctrl();
+        close(fd);
+        free(stats);
+
+        return EXIT_SUCCESS;
+    }
+
     INFO(1, "File %s has inode number %lu\n", filename, stats->st_ino);
     inode = (struct f2fs_inode *)calloc(1, sizeof(struct f2fs_inode));
 
-    do {
-        // we malloc in libf2fs so need to free if we are not using it
-        if (nat_entry) {
-            free(nat_entry);
-        }
-        if (node_block) {
-            free(node_block);
-        }
+    nat = f2fs_load_nat_index(ctrl.bdev.dev_path);
 
-        nat_entry = f2fs_get_inode_nat_entry(ctrl.bdev.dev_path, stats->st_ino);
+    /* the nid of an inode is its inode number */
+    nat_entry = f2fs_get_nat_entry(nat, stats->st_ino);
 
-        // nat_entry is NULL -> no block address found for the inode
-        if (!nat_entry) {
-            ERR_MSG("finding NAT entry for %s with inode %lu\n", filename,
-                    stats->st_ino);
-        }
+    // nat_entry is NULL -> no block address found for the inode
+    if (!nat_entry) {
+        ERR_MSG("finding NAT entry for %s with inode %lu\n", filename,
+                stats->st_ino);
+    }
 
-        node_block =
-            f2fs_get_node_block(ctrl.znsdev.dev_path, nat_entry->block_addr);
-        memcpy(inode, &node_block->i, sizeof(struct f2fs_inode));
+    node_block =
+        f2fs_get_node_block(ctrl.znsdev.dev_path, nat_entry->block_addr);
+    memcpy(inode, &node_block->i, sizeof(struct f2fs_inode));
 
-    } while (!IS_INODE(node_block));
+    if (!IS_INODE(node_block)) {
+        ERR_MSG("node block of %s with inode %lu is not an inode\n", filename,
+                stats->st_ino);
+    }
 
     MSG("================================================================"
         "=\n");
@@ -141,10 +603,12 @@ int main(int argc, char *argv[]) {
 
     cleanup_ctrl();
 
-    free(nat_entry);
+    free(nat);
     free(node_block);
     free(inode);
     free(stats);
+    free(imap_man.files[0].filename);
+    free(imap_man.files);
 
     return EXIT_SUCCESS;
 }
@@ -3,4 +3,40 @@
 
 #include "zns-tools.h"
 
+#include <dirent.h>
+
+#define IMAP_MIN_ENTRIES 64
+#define IMAP_READ_BLOCKS 64    /* max adjacent node blocks read at once */
+#define IMAP_BATCH_BLOCKS 1024 /* max node blocks of a batch of reads */
+
+enum imap_node_type {
+    IMAP_INODE = 0,
+    IMAP_DIRECT,
+    IMAP_INDIRECT,
+    IMAP_DINDIRECT,
+    IMAP_XATTR,
+};
+
+struct imap_node {
+    uint32_t file;     /* index of the owning file in imap_manager.files */
+    uint32_t nid;      /* node id of the node block */
+    uint32_t blk_addr; /* F2FS block address of the node block */
+    uint32_t type;     /* enum imap_node_type of the node block */
+};
+
+struct imap_file {
+    char *filename; /* path of the file */
+    uint64_t ino;   /* inode number of the file */
+};
+
+struct imap_manager {
+    struct imap_file *files; /* files to map in batch mode */
+    uint32_t nr_files;       /* number of files in the array */
+    uint32_t files_cap;      /* allocated entries in files */
+    struct imap_node *nodes; /* all node blocks resolved for the files */
+    uint64_t nr_nodes;       /* number of resolved node blocks */
+    uint64_t nodes_cap;      /* allocated entries in nodes */
+    uint32_t queue_depth;    /* node block reads in flight */
+};
+
 #endif
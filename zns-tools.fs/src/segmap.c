@@ -28,6 +28,8 @@ static void show_info() {
         " data ordering\n");
     MSG("PBAS:   Physical Block Address Start\n");
     MSG("PBAE:   Physical Block Address End\n");
+    MSG("INO:    Inode number owning the blocks (with -r)\n");
+    MSG("NID:    Node ID of the node owning the blocks (with -r)\n");
 }
 
 /*
@@ -42,14 +44,22 @@ static void show_help() {
     MSG("-h\t\tShow this help\n");
     MSG("-l [uint, 0-2]\tLog Level to print\n");
     MSG("-i\t\tResolve inlined file data in inodes\n");
-    MSG("-p\t\tResolve segment information from procfs\n");
+    MSG("-p\t\tResolve segment information from procfs instead of the "
+        "SIT\n");
     MSG("-w\t\tShow extent flags\n");
     MSG("-s [uint]\tSet the starting zone to map. Default zone 1.\n");
     MSG("-z [uint]\tOnly show this single zone\n");
     MSG("-e [uint]\tSet the ending zone to map. Default last zone.\n");
-    MSG("-c\t\tShow segment statistics (requires -p to be enabled).\n");
+    MSG("-c\t\tShow segment statistics.\n");
     MSG("-o\t\tShow only segment statistics (automatically enables -s).\n");
     MSG("-n\t\tDon't show holes between extents (only for Btrfs).\n");
+    MSG("-r\t\tReverse map the valid blocks in the zone range to their "
+        "owning\n\t\tinodes from the SSA, without walking the directory.\n");
+    MSG("-t [uint]\tNumber of threads to collect extents with. Default 1.\n");
+    MSG("-u\t\tDon't sync files before mapping them.\n");
+    MSG("-j [file]\tWrite the segment mappings as json to file.\n");
+    MSG("-b [file]\tWrite the zone map as binary snapshot to file.\n");
+    MSG("-x [file]\tWrite the extents of the zone map as csv to file.\n");
 
     show_info();
     exit(0);
@@ -91,7 +101,8 @@ static void check_dir_init_ctrl() {
         ctrl.znsdev.zone_size = get_zone_size();
         ctrl.znsdev.zone_mask = ~(ctrl.znsdev.zone_size - 1);
         ctrl.znsdev.nr_zones = get_nr_zones();
-        ctrl.fs_manager = f2fs_fs_manager_init(ctrl.bdev.dev_name);
+        ctrl.fs_manager = f2fs_fs_manager_init(ctrl.bdev.dev_path,
+                                               ctrl.offset, ctrl.procfs);
         ctrl.fs_manager_cleanup =
             (fs_manager_cleanup)f2fs_fs_manager_cleanup(ctrl.bdev.dev_name);
         ctrl.fs_info_init = (fs_info_init)f2fs_fs_info_init();
@@ -124,110 +135,449 @@ static void check_dir_init_ctrl() {
 }
 
 /*
- * Collect extents recursively from the path
+ * Join a directory path and an entry name into a new path.
  *
- * @path: char * to path to recursively check
+ * @path: char * to the directory path
+ * @name: char * to the name of the entry in the directory
+ *
+ * returns: char * to the allocated path
  *
  * */
-static void collect_extents(char *path) {
-    struct stat *stats; /* statistics from fstat() call */
-    struct dirent *dir;
-    char *sub_path = NULL;
-    size_t len = 0;
-    int ret = 0;
-    char *filename = NULL;
-    int fd = 0;
+static char *join_path(char *path, char *name) {
+    size_t path_len = strlen(path);
+    size_t name_len = strlen(name);
+    char *joined = malloc(path_len + name_len + 2);
 
-    DIR *directory = opendir(path);
+    if (joined == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
 
-    if (!directory) {
-        ERR_MSG("Failed opening dir %s\n", path);
+    memcpy(joined, path, path_len);
+    if (path_len == 0 || path[path_len - 1] != '/') {
+        joined[path_len] = '/';
+        path_len++;
     }
+    memcpy(&joined[path_len], name, name_len + 1);
 
-    while ((dir = readdir(directory)) != NULL) {
-        if (dir->d_type != DT_DIR) {
-            // TODO: we want to pass the name not set a global field
-            filename = NULL; // NULL so we can realloc
-            filename =
-                realloc(filename, strlen(path) + strlen(dir->d_name) + 2);
-            sprintf(filename, "%s/%s", path, dir->d_name);
+    return joined;
+}
 
-            fd = open(filename, O_RDONLY);
-            fsync(fd);
+/*
+ * Open an entry relative to a directory file descriptor, without updating its
+ * access time. O_NOATIME is only permitted for the owner of the file (or
+ * with CAP_FOWNER), hence without permission it is opened again without it.
+ *
+ * @dirfd: file descriptor of the directory, or AT_FDCWD
+ * @name: char * to the name of the entry (or path for AT_FDCWD)
+ * @flags: flags for openat()
+ *
+ * returns: the file descriptor, -1 on failure with errno set
+ *
+ * */
+static int open_entry(int dirfd, char *name, int flags) {
+    int fd = openat(dirfd, name, flags | O_NOATIME);
+
+    if (fd < 0 && errno == EPERM) {
+        fd = openat(dirfd, name, flags);
+    }
+
+    return fd;
+}
+
+/*
+ * Push a directory onto the shared directory queue of the walker threads.
+ * Queued directories keep their file descriptor open, such that their
+ * entries are opened relative to it, unless WALK_QUEUE_MAX_FDS directories
+ * in the queue are already open, in which case it is reopened by its path.
+ *
+ * @fd: file descriptor of the directory, or -1 to open it by its path
+ * @path: char * to the directory path, ownership is passed to the queue
+ *
+ * */
+static void push_dir(int fd, char *path) {
+    struct walk_queue *queue = &segmap_man.wq;
+    struct walk_dir *temp = NULL;
+
+    pthread_mutex_lock(&queue->lock);
 
-            if (fd < 0) {
-                // The file could have been deleted in the meantime.
-                if (access(filename, F_OK) != 0) {
-                    INFO(1, "File no longer exists: %s", filename);
+    if (queue->nr_dirs == queue->cap) {
+        queue->cap = queue->cap == 0 ? WALK_QUEUE_MIN_ENTRIES : queue->cap << 1;
+        temp = realloc(queue->dirs, sizeof(struct walk_dir) * queue->cap);
+        if (temp == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        queue->dirs = temp;
+    }
+
+    if (fd >= 0 && queue->nr_fds == WALK_QUEUE_MAX_FDS) {
+        close(fd);
+        fd = -1;
+    } else if (fd >= 0) {
+        queue->nr_fds++;
+    }
+
+    queue->dirs[queue->nr_dirs].fd = fd;
+    queue->dirs[queue->nr_dirs].path = path;
+    queue->nr_dirs++;
+
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * Pop a directory from the shared directory queue, waiting while the queue is
+ * empty but other threads are still walking directories (which can push new
+ * directories).
+ *
+ * @dir: struct walk_dir * to store the popped directory in
+ *
+ * returns: 1 if a directory is popped, 0 once all directories are walked
+ *
+ * */
+static uint8_t pop_dir(struct walk_dir *dir) {
+    struct walk_queue *queue = &segmap_man.wq;
+    uint8_t popped = 0;
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->nr_dirs == 0 && queue->busy > 0) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+
+    if (queue->nr_dirs > 0) {
+        queue->nr_dirs--;
+        *dir = queue->dirs[queue->nr_dirs];
+        if (dir->fd >= 0) {
+            queue->nr_fds--;
+        }
+        queue->busy++;
+        popped = 1;
+    } else {
+        /* wake up the remaining waiting threads to finish as well */
+        pthread_cond_broadcast(&queue->cond);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return popped;
+}
+
+/*
+ * Mark a popped directory as completely walked.
+ *
+ * */
+static void finish_dir() {
+    struct walk_queue *queue = &segmap_man.wq;
+
+    pthread_mutex_lock(&queue->lock);
+
+    queue->busy--;
+    if (queue->busy == 0 && queue->nr_dirs == 0) {
+        pthread_cond_broadcast(&queue->cond);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * Retrieve the extents of a file into the buffer of the walker thread.
+ *
+ * @walker: struct walk_thread * of the calling thread
+ * @dir: struct walk_dir * of the directory the file is in
+ * @name: char * to the name of the file in the directory
+ *
+ * */
+static void walk_file(struct walk_thread *walker, struct walk_dir *dir,
+                      char *name) {
+    struct walk_file *temp = NULL;
+    uint32_t ext_off = walker->buf.nr_extents;
+    int fd;
+
+    fd = open_entry(dir->fd, name, O_RDONLY | O_NOFOLLOW);
+
+    if (fd < 0) {
+        // The file could have been deleted in the meantime.
+        if (errno == ENOENT) {
+            INFO(1, "File no longer exists: %s/%s\n", dir->path, name);
+            return;
+        } else {
+            ERR_MSG("failed opening file %s/%s\n", dir->path, name);
+        }
+    }
+
+    if (!ctrl.no_sync) {
+        fsync(fd);
+    }
+
+    if (retrieve_extents(fd, &walker->buf) == EXIT_FAILURE) {
+        ERR_MSG("retrieving extents for %s/%s\n", dir->path, name);
+    }
+
+    close(fd);
+
+    if (walker->nr_files == walker->files_cap) {
+        walker->files_cap = walker->files_cap == 0 ? FILE_COUNTER_MIN_ENTRIES
+                                                   : walker->files_cap << 1;
+        temp = realloc(walker->files,
+                       sizeof(struct walk_file) * walker->files_cap);
+        if (temp == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        walker->files = temp;
+    }
+
+    walker->files[walker->nr_files].filename = join_path(dir->path, name);
+    walker->files[walker->nr_files].ext_off = ext_off;
+    walker->files[walker->nr_files].nr_extents =
+        walker->buf.nr_extents - ext_off;
+    walker->files[walker->nr_files].ext_ctr = walker->buf.file_ext_ctr;
+    walker->nr_files++;
+}
+
+/*
+ * Get the type of a directory entry. The d_type from getdents64() is used
+ * directly, only if the file system does not fill it, the entry is stat'ed.
+ *
+ * @dir: struct walk_dir * of the directory the entry is in
+ * @dent: struct linux_dirent64 * of the entry
+ *
+ * returns: DT_REG, DT_DIR, or DT_UNKNOWN for all other entries
+ *
+ * */
+static uint8_t get_dent_type(struct walk_dir *dir,
+                             struct linux_dirent64 *dent) {
+    struct stat stats;
+
+    if (dent->d_type == DT_REG || dent->d_type == DT_DIR) {
+        return dent->d_type;
+    } else if (dent->d_type != DT_UNKNOWN) {
+        return DT_UNKNOWN;
+    }
+
+    if (fstatat(dir->fd, dent->d_name, &stats, AT_SYMLINK_NOFOLLOW) < 0) {
+        return DT_UNKNOWN;
+    }
+
+    if (S_ISREG(stats.st_mode)) {
+        return DT_REG;
+    } else if (S_ISDIR(stats.st_mode)) {
+        return DT_DIR;
+    }
+
+    return DT_UNKNOWN;
+}
+
+/*
+ * Walker thread, which pops directories from the shared queue, retrieves the
+ * extents of all regular files in the directory into its own buffer, and
+ * pushes the subdirectories back to the queue, until all directories are
+ * walked. Entries are read with getdents64() and opened relative to the
+ * directory file descriptor, and symbolic links are not followed.
+ *
+ * @arg: struct walk_thread * of the thread
+ *
+ * */
+static void *walk_dirs(void *arg) {
+    struct walk_thread *walker = (struct walk_thread *)arg;
+    struct linux_dirent64 *dent;
+    struct walk_dir dir;
+    char *dents;
+    long nread;
+    int fd;
+
+    dents = malloc(WALK_DENTS_BYTES);
+    if (dents == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    while (pop_dir(&dir)) {
+        if (dir.fd < 0) {
+            dir.fd = open_entry(AT_FDCWD, dir.path,
+                                O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+            if (dir.fd < 0) {
+                ERR_MSG("Failed opening dir %s\n", dir.path);
+            }
+        }
+
+        while ((nread = syscall(SYS_getdents64, dir.fd, dents,
+                                WALK_DENTS_BYTES)) > 0) {
+            for (long off = 0; off < nread; off += dent->d_reclen) {
+                dent = (struct linux_dirent64 *)&dents[off];
+
+                if (strcmp(dent->d_name, ".") == 0 ||
+                    strcmp(dent->d_name, "..") == 0) {
                     continue;
-                } else {
-                    ERR_MSG("failed opening file %s\n", filename);
+                }
+
+                switch (get_dent_type(&dir, dent)) {
+                case DT_REG:
+                    walk_file(walker, &dir, dent->d_name);
+                    break;
+                case DT_DIR:
+                    fd = open_entry(dir.fd, dent->d_name,
+                                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+                    if (fd >= 0) {
+                        push_dir(fd, join_path(dir.path, dent->d_name));
+                    } else if (errno == ENOENT) {
+                        INFO(1, "Dir no longer exists: %s/%s\n", dir.path,
+                             dent->d_name);
+                    } else {
+                        ERR_MSG("Failed opening dir %s/%s\n", dir.path,
+                                dent->d_name);
+                    }
+                    break;
+                default:
+                    break;
                 }
             }
+        }
 
-            stats = calloc(1, sizeof(struct stat));
+        if (nread < 0) {
+            ERR_MSG("Failed reading dir %s\n", dir.path);
+        }
 
-            if (fstat(fd, stats) < 0) {
-                ERR_MSG("Failed stat on file %s\n", filename);
-            }
+        close(dir.fd);
+        free(dir.path);
+        finish_dir();
+    }
 
-            ret = get_extents(filename, fd, stats);
+    free(dents);
 
+    return NULL;
+}
+
+/*
+ * Collect the extents of all regular files in the path recursively. The
+ * directory tree is walked by segmap_man.nr_threads threads, which share a
+ * queue of directories that remain to be walked, and each retrieve extents
+ * into their own buffer. Once all threads finish, the buffers are mapped into
+ * the zonemap by the calling thread.
+ *
+ * @path: char * to the path to collect extents in
+ *
+ * */
+static void collect_extents(char *path) {
+    struct walk_thread *walkers;
+    struct walk_file *file;
+    uint32_t nr_files = 0;
+    int ret = 0, fd;
+
+    walkers = calloc(segmap_man.nr_threads, sizeof(struct walk_thread));
+    if (walkers == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    pthread_mutex_init(&segmap_man.wq.lock, NULL);
+    pthread_cond_init(&segmap_man.wq.cond, NULL);
+    fd = open_entry(AT_FDCWD, path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        ERR_MSG("Failed opening dir %s\n", path);
+    }
+    push_dir(fd, strdup(path));
+
+    for (uint32_t i = 0; i < segmap_man.nr_threads; i++) {
+        ret = pthread_create(&walkers[i].thread, NULL, walk_dirs, &walkers[i]);
+        if (ret != 0) {
+            ERR_MSG("Failed creating walker thread\n");
+        }
+    }
+
+    for (uint32_t i = 0; i < segmap_man.nr_threads; i++) {
+        pthread_join(walkers[i].thread, NULL);
+        nr_files += walkers[i].nr_files;
+    }
+
+    reserve_file_counter_map(nr_files);
+
+    for (uint32_t i = 0; i < segmap_man.nr_threads; i++) {
+        for (uint32_t j = 0; j < walkers[i].nr_files; j++) {
+            file = &walkers[i].files[j];
+
+            ret = map_file_extents(file->filename,
+                                   &walkers[i].buf.extents[file->ext_off],
+                                   file->nr_extents, file->ext_ctr);
             if (ret == EXIT_FAILURE) {
-                ERR_MSG("retrieving extents for %s\n", filename);
-            } else if (ctrl.zonemap->extent_ctr == 0) {
-                ERR_MSG("No extents found on device\n");
+                ERR_MSG("mapping extents for %s\n", file->filename);
             }
 
-            // TODO: have file counter map with number of extents and check if
-            // none found
-            /* if (!temp_map || temp_map->ext_ctr == 0) { */
-            /*     INFO(1, "No extents found for file: %s\n", ctrl.filename); */
-            /* } else { */
-            /*     glob_extent_map->ext_ctr += temp_map->ext_ctr; */
-            /*     glob_extent_map->cum_extent_size +=
-             * temp_map->cum_extent_size; */
-            /*     glob_extent_map = realloc( */
-            /*         glob_extent_map, */
-            /*         sizeof(struct extent_map) + */
-            /*             sizeof(struct extent) * (glob_extent_map->ext_ctr +
-             * 1)); */
-            /*     memcpy(&glob_extent_map->extent[glob_extent_map->ext_ctr - */
-            /*                                     temp_map->ext_ctr], */
-            /*            temp_map->extent, */
-            /*            sizeof(struct extent) * temp_map->ext_ctr); */
-            /* } */
+            free(file->filename);
+        }
 
-            close(fd);
-            free(stats);
-        } else if (dir->d_type == DT_DIR && strcmp(dir->d_name, ".") != 0 &&
-                   strcmp(dir->d_name, "..") != 0) {
-            len = strlen(path) + strlen(dir->d_name) + 2;
-            sub_path = realloc(sub_path, len);
+        ctrl.range_extent_ctr += walkers[i].buf.range_extent_ctr;
 
-            snprintf(sub_path, len, "%s/%s/", path, dir->d_name);
-            collect_extents(sub_path);
-        }
+        free(walkers[i].files);
+        free(walkers[i].buf.extents);
     }
 
-    if (filename != NULL) {
-        free(filename);
+    pthread_cond_destroy(&segmap_man.wq.cond);
+    pthread_mutex_destroy(&segmap_man.wq.lock);
+    free(segmap_man.wq.dirs);
+    free(walkers);
+}
+
+/*
+ * Print the header with the location of a segment
+ *
+ * @segment_start: segment number on the ZNS device
+ *
+ * */
+static void show_segment_info_header(uint64_t segment_start) {
+    struct rep_line line = {0};
+
+    if (ctrl.show_only_stats) {
+        return;
     }
 
-    free(sub_path);
-    closedir(directory);
+    REP_UNDERSCORE
+    REP_FORMATTER
+    rep_add_str(&line, "SEGMENT: ");
+    rep_add_uint(&line, segment_start, 4);
+    rep_add_range(&line, segment_start << ctrl.segment_shift,
+                  (segment_start << ctrl.segment_shift) +
+                      ctrl.f2fs_segment_sectors,
+                  ctrl.f2fs_segment_sectors);
+    rep_add_str(&line, "\n");
+    rep_write(&line);
+}
+
+/*
+ * Print an extent, or the part of an extent in a segment
+ *
+ * @pbas: first sector of the extent (part)
+ * @pbae: end sector of the extent (part)
+ * @size: number of sectors of the extent (part)
+ * @extent: struct extent * to print the file and extent number of
+ *
+ * */
+static void show_extent(uint64_t pbas, uint64_t pbae, uint64_t size,
+                        struct extent *extent) {
+    struct rep_line line = {0};
+
+    if (ctrl.show_only_stats) {
+        return;
+    }
+
+    rep_add_str(&line, "***** EXTENT:");
+    rep_add_range(&line, pbas, pbae, size);
+    rep_add_str(&line, "  FILE: ");
+    rep_add_str_right(&line, get_file_name(extent->fileID), 50);
+    rep_add_str(&line, "  EXTID:  ");
+    rep_add_uint(&line, extent->ext_nr + 1, 0);
+    rep_add_str(&line, "/");
+    rep_add_uint(&line, get_file_extent_count(extent->fileID), 5);
+    rep_add_str(&line, "\n");
+    rep_write(&line);
 }
 
 static void show_segment_info(struct extent *extent, uint64_t segment_start) {
+    /* nothing of the segment is shown with only the stats */
+    if (ctrl.show_only_stats) {
+        ctrl.cur_segment = segment_start;
+        return;
+    }
+
     if (ctrl.cur_segment != segment_start) {
-        REP_UNDERSCORE
-        REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            "SEGMENT: %-4lu  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "\n",
-            segment_start, segment_start << ctrl.segment_shift,
-            ((segment_start << ctrl.segment_shift) + ctrl.f2fs_segment_sectors),
-            ctrl.f2fs_segment_sectors);
+        show_segment_info_header(segment_start);
 
         // TODO: still need the procfs flag? any fs can enable and show here
         // what it want, a bit iffy with the other functions that purely map to
@@ -255,38 +605,29 @@ static void show_beginning_segment(struct extent *extent) {
     uint64_t segment_start = (extent->phy_blk & ctrl.f2fs_segment_mask);
     uint64_t segment_end = segment_start + (ctrl.f2fs_segment_sectors);
 
-    REP(ctrl.show_only_stats,
-        "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-        "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-        extent->phy_blk, segment_end, segment_end - extent->phy_blk,
-        extent->file, extent->ext_nr + 1, get_file_extent_count(extent->file));
+    show_extent(extent->phy_blk, segment_end, segment_end - extent->phy_blk,
+                extent);
 }
 
 /*
- * Get the index in segmap_man.fs for the filename
+ * Get the index in segmap_man.fs for the file of the extent
  *
- * @filename: filename to get index of
+ * @extent: extent to get the file stats index of
  *
- * Note, creates a new fs entry if the file entry does not exits yet.
- * segmap_man.ctr indicates the number of initialized entries.
+ * Note, the index is the fileID of the extent, initializes the fs entry if it
+ * is not initialized yet. segmap_man.ctr indicates the number of initialized
+ * entries.
  *
  * */
-static unsigned int get_file_stats_index(char *filename) {
-    uint32_t i = 0;
+static unsigned int get_file_stats_index(struct extent *extent) {
+    struct file_stats *fs = &segmap_man.fs[extent->fileID];
 
-    for (i = 0; i < segmap_man.ctr; i++) {
-        if (strlen(segmap_man.fs[i].filename) == strlen(filename) &&
-            strncmp(segmap_man.fs[i].filename, filename, MAX_FILE_LENGTH) ==
-                0) {
-            return i;
-        }
+    if (fs->filename == NULL) {
+        fs->filename = ctrl.file_counter_map->files[extent->fileID].file;
+        segmap_man.ctr++;
     }
 
-    segmap_man.fs[i].filename = calloc(1, MAX_FILE_LENGTH);
-    memcpy(segmap_man.fs[i].filename, filename, MAX_FILE_LENGTH);
-    segmap_man.ctr++;
-
-    return i;
+    return extent->fileID;
 }
 
 /*
@@ -311,7 +652,7 @@ static void set_segment_counters(uint32_t num_segments, struct extent *extent) {
     segmap_man.segment_ctr += num_segments;
 
     if (ctrl.show_class_stats && ctrl.nr_files > 1) {
-        fs_stats_index = get_file_stats_index(extent->file);
+        fs_stats_index = get_file_stats_index(extent);
         segmap_man.fs[fs_stats_index].segment_ctr += num_segments;
         if (segmap_man.fs[fs_stats_index].last_zone != extent->zone) {
             segmap_man.fs[fs_stats_index].last_zone = extent->zone;
@@ -361,9 +702,7 @@ static void show_consecutive_segments(struct extent *extent,
         ctrl.segment_shift;
     uint64_t num_segments = segment_end - segment_start;
 
-    // TODO: we don't need ctrl.procfs anymore, it will be resolved if exists,
-    // otherwise not
-    if (ctrl.show_class_stats && ctrl.procfs) {
+    if (ctrl.show_class_stats) {
         /* num_segments + 1 because the ending segment is included, but we only
          * use its starting LBA */
         set_segment_counters(num_segments + 1, extent);
@@ -374,21 +713,25 @@ static void show_consecutive_segments(struct extent *extent,
          * in the next segment then we just want to show the 1st segment (2nd
          * segment will be printed in the function after this) */
         show_segment_info(extent, segment_start);
-        REP(ctrl.show_only_stats,
-            "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-            segment_start, segment_end << ctrl.segment_shift,
-            (unsigned long)ctrl.f2fs_segment_sectors, extent->file,
-            extent->ext_nr + 1, get_file_extent_count(extent->file));
+        show_extent(segment_start, segment_end << ctrl.segment_shift,
+                    ctrl.f2fs_segment_sectors, extent);
     } else {
         REP_UNDERSCORE
         REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            ">>>>> SEGMENT RANGE: %-4lu-%-4lu   PBAS: %#-10" PRIx64
-            "  PBAE: %#-10" PRIx64 "  SIZE: %#-10" PRIx64 "\n",
-            segment_start, segment_end - 1, segment_start << ctrl.segment_shift,
-            segment_end << ctrl.segment_shift,
-            num_segments * ctrl.f2fs_segment_sectors);
+        if (!ctrl.show_only_stats) {
+            struct rep_line line = {0};
+
+            rep_add_str(&line, ">>>>> SEGMENT RANGE: ");
+            rep_add_uint(&line, segment_start, 4);
+            rep_add_str(&line, "-");
+            rep_add_uint(&line, segment_end - 1, 4);
+            rep_add_str(&line, " ");
+            rep_add_range(&line, segment_start << ctrl.segment_shift,
+                          segment_end << ctrl.segment_shift,
+                          num_segments * ctrl.f2fs_segment_sectors);
+            rep_add_str(&line, "\n");
+            rep_write(&line);
+        }
 
         // Since segments are in the same zone, they must be of the same type
         // therefore, we can just print the flags of the first one, and since
@@ -399,13 +742,9 @@ static void show_consecutive_segments(struct extent *extent,
         show_segment_info(extent, segment_start);
 
         REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-            segment_start << ctrl.segment_shift,
-            segment_end << ctrl.segment_shift,
-            num_segments * ctrl.f2fs_segment_sectors, extent->file,
-            extent->ext_nr + 1, get_file_extent_count(extent->file));
+        show_extent(segment_start << ctrl.segment_shift,
+                    segment_end << ctrl.segment_shift,
+                    num_segments * ctrl.f2fs_segment_sectors, extent);
     }
 }
 
@@ -422,12 +761,111 @@ static void show_remainder_segment(struct extent *extent) {
         extent->phy_blk + extent->len - (segment_start << ctrl.segment_shift);
 
     show_segment_info(extent, segment_start);
-    REP(ctrl.show_only_stats,
-        "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-        "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-        segment_start << ctrl.segment_shift,
-        (segment_start << ctrl.segment_shift) + remainder, remainder,
-        extent->file, extent->ext_nr + 1, get_file_extent_count(extent->file));
+    show_extent(segment_start << ctrl.segment_shift,
+                (segment_start << ctrl.segment_shift) + remainder, remainder,
+                extent);
+}
+
+/*
+ * Estimate the GC cost of a zone from the valid blocks in its segments, up to
+ * the write pointer of the zone.
+ *
+ * @zone: zone number to estimate
+ * @gc: struct f2fs_gc_estimate * to set
+ *
+ * returns: 1 if the estimate is set, 0 if there is no segment information
+ *
+ * */
+static uint8_t get_zone_gc_estimate(uint32_t zone,
+                                    struct f2fs_gc_estimate *gc) {
+    struct zone *z = &ctrl.zonemap->zones[zone];
+    uint64_t wp = z->wp > z->end ? z->end : z->wp;
+    uint64_t written_blocks = 0;
+
+    if (wp > z->start) {
+        written_blocks =
+            (wp - z->start) << ctrl.sector_shift >> F2FS_BLKSIZE_BITS;
+    }
+
+    return f2fs_estimate_gc(ctrl.fs_manager, z->start >> ctrl.segment_shift,
+                            written_blocks, gc);
+}
+
+/*
+ * Get the share of written blocks in percent that GC has to migrate
+ *
+ * */
+static uint64_t get_gc_cost(struct f2fs_gc_estimate *gc) {
+    if (gc->valid_blocks + gc->dead_blocks == 0) {
+        return 0;
+    }
+
+    return gc->valid_blocks * 100 / (gc->valid_blocks + gc->dead_blocks);
+}
+
+/*
+ * Show the GC estimate of a zone below its zone information
+ *
+ * @zone: zone number to show the estimate of
+ *
+ * */
+static void show_zone_gc_estimate(uint32_t zone) {
+    struct f2fs_gc_estimate gc;
+
+    if (!get_zone_gc_estimate(zone, &gc)) {
+        return;
+    }
+
+    MSG("GC ESTIMATE:  SEGMENTS: %-5u  VALID BLOCKS: %#-10" PRIx64
+        "  DEAD BLOCKS: %#-10" PRIx64 "  COST: %3lu%%\n",
+        gc.nr_segments,
+        gc.valid_blocks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift,
+        gc.dead_blocks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift,
+        get_gc_cost(&gc));
+}
+
+/*
+ * Show the open logs of F2FS in a zone below its zone information, with the
+ * gap between the log head of the last checkpoint and the write pointer of
+ * the zone. Blocks in the gap were written after the checkpoint, e.g., for
+ * fsync() or by the log advancing since.
+ *
+ * @zone: zone number to show the open logs of
+ *
+ * */
+static void show_zone_logs(uint32_t zone) {
+    struct zone *z = &ctrl.zonemap->zones[zone];
+    uint64_t wp = z->wp > z->end ? z->end : z->wp;
+    uint64_t head;
+    uint32_t segment, blkoff;
+    uint8_t alloc_type;
+
+    for (uint8_t i = 0; i < NR_CURSEG_TYPE; i++) {
+        if (!f2fs_get_curseg(ctrl.fs_manager, i, &segment, &blkoff,
+                             &alloc_type)) {
+            continue;
+        }
+
+        head = ((uint64_t)segment << ctrl.segment_shift) +
+               ((uint64_t)blkoff << F2FS_BLKSIZE_BITS >> ctrl.sector_shift);
+        if (head < z->start || head >= z->start + z->size) {
+            continue;
+        }
+
+        /* an SSR log fills invalid blocks of a dirty segment, its head is
+         * not written sequentially up to the write pointer */
+        if (alloc_type == SSR) {
+            MSG("OPEN LOG:  TYPE: %-16s  ALLOC: SSR  SEGMENT: %-8u  LOG HEAD: "
+                "%#-10" PRIx64 "  WP: %#-10" PRIx64 "  GAP: n/a\n",
+                f2fs_type_name(i), segment, head, wp);
+            continue;
+        }
+
+        MSG("OPEN LOG:  TYPE: %-16s  ALLOC: LFS  SEGMENT: %-8u  LOG HEAD: "
+            "%#-10" PRIx64 "  WP: %#-10" PRIx64 "  GAP: %s%#" PRIx64 "\n",
+            f2fs_type_name(i), segment, head, wp, wp < head ? "-" : "",
+            wp < head ? head - wp : wp - head);
+    }
 }
 
 /*
@@ -435,6 +873,8 @@ static void show_remainder_segment(struct extent *extent) {
  *
  * */
 static void show_segment_stats() {
+    struct f2fs_gc_estimate gc;
+
     REP(ctrl.show_only_stats, "\n\n");
     EQUAL_FORMATTER
     MSG("\t\t\tSEGMENT STATS");
@@ -467,6 +907,20 @@ static void show_segment_stats() {
             "-", "-");
     }
 
+    if (ctrl.delalloc_extent_ctr > 0) {
+        FORMATTER
+        MSG("%-50s | %-17lu | %-28s | %-25s | %-13s | %-13s | %-13s\n",
+            "FIEMAP_EXTENT_DELALLOC", ctrl.delalloc_extent_ctr, "-", "-", "-",
+            "-", "-");
+    }
+
+    if (ctrl.range_extent_ctr > 0) {
+        FORMATTER
+        MSG("%-50s | %-17lu | %-28s | %-25s | %-13s | %-13s | %-13s\n",
+            "Outside of zone range", ctrl.range_extent_ctr, "-", "-", "-",
+            "-", "-");
+    }
+
     // TODO: show summary for a single file
     // Show the per file statistics of directory if has more than 1 file
     if (segmap_man.isdir && ctrl.nr_files > 1) {
@@ -483,6 +937,29 @@ static void show_segment_stats() {
                 ctrl.file_counter_map->files[i].hot_ctr);
         }
     }
+
+    if (ctrl.fs_manager == NULL) {
+        return;
+    }
+
+    /* GC estimate of the zones that were mapped, in the mapped zone range */
+    UNDERSCORE_FORMATTER
+    FORMATTER
+    MSG("%-50s | %-17s | %-28s | %-25s | %-13s\n", "Zone", "Written Segments",
+        "Valid Blocks", "Dead Blocks", "GC Cost (%)");
+    FORMATTER
+    for (uint32_t i = ctrl.start_zone > 0 ? ctrl.start_zone - 1 : 0;
+         i < ctrl.end_zone && i < ctrl.zonemap->nr_zones; i++) {
+        if (ctrl.zonemap->zones[i].extent_ctr == 0 ||
+            !get_zone_gc_estimate(i, &gc)) {
+            continue;
+        }
+
+        MSG("%-50u | %-17u | %-28lu | %-25lu | %-13lu\n", i, gc.nr_segments,
+            gc.valid_blocks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift,
+            gc.dead_blocks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift,
+            get_gc_cost(&gc));
+    }
 }
 
 /*
@@ -490,7 +967,7 @@ static void show_segment_stats() {
  *
  * */
 static void show_segment_report() {
-    struct node *current;
+    struct extent *current;
     uint32_t i = 0;
     uint32_t current_zone = 0;
     uint64_t segment_id = 0;
@@ -503,8 +980,11 @@ static void show_segment_report() {
         segmap_man.fs = calloc(1, sizeof(struct file_stats) * ctrl.nr_files);
     }
 
+    update_zone_map();
+    sort_zone_map();
+
     REP_EQUAL_FORMATTER
-    REP(ctrl.show_only_stats, "\t\t\tSEGMENT MAPPINGS\n");
+    REP_PUTS(ctrl.show_only_stats, "\t\t\tSEGMENT MAPPINGS\n");
     REP_EQUAL_FORMATTER
 
     for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
@@ -512,10 +992,9 @@ static void show_segment_report() {
             continue;
         }
 
-        current = ctrl.zonemap->zones[i].extents_head;
-
-        while (current) {
-            segment_id = (current->extent->phy_blk & ctrl.f2fs_segment_mask) >>
+        for (uint32_t j = 0; j < ctrl.zonemap->zones[i].extent_ctr; j++) {
+            current = ctrl.zonemap->zones[i].extents[j];
+            segment_id = (current->phy_blk & ctrl.f2fs_segment_mask) >>
                          ctrl.segment_shift;
             if ((segment_id << ctrl.segment_shift) >= end_lba) {
                 break;
@@ -525,24 +1004,24 @@ static void show_segment_report() {
                 continue;
             }
 
-            if (current_zone != current->extent->zone) {
+            if (current_zone != current->zone) {
                 if (current_zone != 0) {
                     REP_FORMATTER
                 }
 
-                current_zone = current->extent->zone;
+                current_zone = current->zone;
                 if (!ctrl.show_only_stats) {
                     print_zone_info(current_zone);
+                    show_zone_gc_estimate(current_zone);
+                    show_zone_logs(current_zone);
                 }
             }
 
             uint64_t segment_start =
-                (current->extent->phy_blk & ctrl.f2fs_segment_mask);
-            uint64_t extent_end =
-                current->extent->phy_blk + current->extent->len;
+                (current->phy_blk & ctrl.f2fs_segment_mask);
+            uint64_t extent_end = current->phy_blk + current->len;
             uint64_t segment_end =
-                ((current->extent->phy_blk + current->extent->len) &
-                 ctrl.f2fs_segment_mask) >>
+                ((current->phy_blk + current->len) & ctrl.f2fs_segment_mask) >>
                 ctrl.segment_shift;
 
             /* Can be zero if file starts and ends in same segment therefore + 1
@@ -553,9 +1032,9 @@ static void show_segment_report() {
             /* Extent can only be a single file so add all segments we have here
              */
             /* if (ctrl.procfs) { */
-            increase_file_segment_counter(current->extent->file, num_segments,
-                                          segment_id, current->extent->fs_info,
-                                          current->extent->zone_cap);
+            increase_file_segment_counter(
+                current->fileID, num_segments, segment_id, current->fs_info,
+                ctrl.zonemap->zones[current->zone].capacity);
             /* } */
 
             /* if the beginning of the extent and the ending of the extent are
@@ -564,37 +1043,31 @@ static void show_segment_report() {
                 extent_end == (segment_start +
                                (F2FS_SEGMENT_BYTES >> ctrl.sector_shift))) {
                 if (segment_id != ctrl.cur_segment) {
-                    show_segment_info(current->extent, segment_id);
+                    show_segment_info(current, segment_id);
                     ctrl.cur_segment = segment_id;
                     /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
+                    set_segment_counters(1, current);
                     /* } */
                 }
 
-                REP(ctrl.show_only_stats,
-                    "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-                    current->extent->phy_blk,
-                    current->extent->phy_blk + current->extent->len,
-                    current->extent->len, current->extent->file,
-                    current->extent->ext_nr + 1,
-                    get_file_extent_count(current->extent->file));
+                show_extent(current->phy_blk, current->phy_blk + current->len,
+                            current->len, current);
             } else {
                 /* Else the extent spans across multiple segments, so we need to
                  * break it up */
 
                 /* part 1: the beginning of extent to end of that single segment
                  */
-                if (current->extent->phy_blk != segment_start) {
+                if (current->phy_blk != segment_start) {
                     if (segment_id != ctrl.cur_segment) {
-                        uint64_t segment_start = (current->extent->phy_blk &
-                                                  ctrl.f2fs_segment_mask) >>
-                                                 ctrl.segment_shift;
-                        show_segment_info(current->extent, segment_start);
+                        uint64_t segment_start =
+                            (current->phy_blk & ctrl.f2fs_segment_mask) >>
+                            ctrl.segment_shift;
+                        show_segment_info(current, segment_start);
                     }
-                    show_beginning_segment(current->extent);
+                    show_beginning_segment(current);
                     /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
+                    set_segment_counters(1, current);
                     /* } */
                     segment_id++;
                 }
@@ -603,30 +1076,240 @@ static void show_segment_report() {
                  * last (in case the last is only partially used by the segment)
                  * - checks if there are more than 1 segments after the start */
                 uint64_t segment_end =
-                    ((current->extent->phy_blk + current->extent->len) &
+                    ((current->phy_blk + current->len) &
                      ctrl.f2fs_segment_mask);
                 if ((segment_end - segment_start) >> ctrl.segment_shift > 1)
-                    show_consecutive_segments(current->extent, segment_id);
+                    show_consecutive_segments(current, segment_id);
 
                 /* part 3: any remaining parts of the last segment, which do not
                  * fill the entire last segment only if the segment actually has
                  * a remaining fragment */
-                if (segment_end !=
-                    current->extent->phy_blk + current->extent->len) {
-                    show_remainder_segment(current->extent);
+                if (segment_end != current->phy_blk + current->len) {
+                    show_remainder_segment(current);
                     /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
+                    set_segment_counters(1, current);
                     /* } */
                 }
             }
-
-            current = current->next;
         }
     }
 
     show_segment_stats();
 }
 
+/*
+ * Print a run of blocks from the reverse mapping
+ *
+ * @run: struct rmap_run * to print
+ *
+ * */
+static void show_rmap_run(struct rmap_run *run) {
+    uint64_t size = (uint64_t)run->nr_blks << F2FS_BLKSIZE_BITS >>
+                    ctrl.sector_shift;
+
+    REP(ctrl.show_only_stats,
+        "***** BLOCKS:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
+        "  SIZE: %#-10" PRIx64 "  INO: %-10u  NID: %-10u  TYPE: %s\n",
+        run->pbas, run->pbas + size, size, run->ino, run->nid,
+        run->node ? "NODE" : "DATA");
+}
+
+static int cmp_rmap_owner(const void *a, const void *b) {
+    uint64_t owner_a = *(uint64_t *)a;
+    uint64_t owner_b = *(uint64_t *)b;
+
+    return (owner_a > owner_b) - (owner_a < owner_b);
+}
+
+/*
+ * Show the owners of the valid blocks of a zone, with the number of data and
+ * node blocks of each inode
+ *
+ * @owners: owner of each valid block in the zone, as inode << 1 | node flag
+ * @nr_owners: number of entries in owners
+ *
+ * */
+static void show_rmap_owners(uint64_t *owners, uint64_t nr_owners) {
+    uint64_t i = 0, data_blks, node_blks, nr_inodes = 0;
+    uint32_t ino;
+
+    qsort(owners, nr_owners, sizeof(uint64_t), cmp_rmap_owner);
+
+    for (uint64_t j = 0; j < nr_owners; j++) {
+        if (j == 0 || owners[j] >> 1 != owners[j - 1] >> 1) {
+            nr_inodes++;
+        }
+    }
+
+    REP_UNDERSCORE
+    MSG("+++++ OWNERS: %-10lu  VALID BLOCKS: %#-10" PRIx64 "\n", nr_inodes,
+        nr_owners << F2FS_BLKSIZE_BITS >> ctrl.sector_shift);
+    REP_FORMATTER
+
+    while (i < nr_owners) {
+        ino = owners[i] >> 1;
+        data_blks = 0;
+        node_blks = 0;
+
+        for (; i < nr_owners && owners[i] >> 1 == ino; i++) {
+            if (owners[i] & 1) {
+                node_blks++;
+            } else {
+                data_blks++;
+            }
+        }
+
+        MSG("INO: %-10u  DATA BLOCKS: %#-10" PRIx64
+            "  NODE BLOCKS: %#-10" PRIx64 "\n",
+            ino, data_blks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift,
+            node_blks << F2FS_BLKSIZE_BITS >> ctrl.sector_shift);
+    }
+}
+
+/*
+ * Map the valid blocks of a zone to their owning nid and inode from the
+ * summaries of its segments in the SSA, and the NAT.
+ *
+ * @zone: zone number to map
+ * @nat: struct f2fs_nat_index * loaded NAT
+ * @owners: uint64_t ** array to collect the owner of each valid block in,
+ * reallocated to fit the zone
+ *
+ * */
+static void reverse_map_zone(uint32_t zone, struct f2fs_nat_index *nat,
+                             uint64_t **owners) {
+    struct segment_manager *segman = ctrl.fs_manager;
+    struct zone *z = &ctrl.zonemap->zones[zone];
+    struct f2fs_summary_block *sum_blocks = NULL;
+    struct f2fs_nat_entry *nat_entry = NULL;
+    struct segment_info seg_i;
+    struct rmap_run run = {0};
+    uint32_t blocks_per_seg = 1 << f2fs_sb.log_blocks_per_seg;
+    uint32_t first_segment = z->start >> ctrl.segment_shift;
+    uint32_t nr_segments = z->capacity >> ctrl.segment_shift;
+    uint32_t segno, nid, ino;
+    uint64_t nr_owners = 0, pbas;
+    uint8_t node;
+
+    segno = first_segment + segman->zns_segno_offset;
+    if (segno >= segman->nr_segments) {
+        return;
+    }
+    if (nr_segments > segman->nr_segments - segno) {
+        nr_segments = segman->nr_segments - segno;
+    }
+
+    sum_blocks = f2fs_read_ssa(ctrl.bdev.dev_path, segno, nr_segments);
+    if (sum_blocks == NULL) {
+        return;
+    }
+
+    *owners = realloc(*owners, sizeof(uint64_t) * (uint64_t)nr_segments *
+                                   blocks_per_seg);
+    if (*owners == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    if (!ctrl.show_only_stats) {
+        print_zone_info(zone);
+        show_zone_logs(zone);
+    }
+
+    for (uint32_t i = 0; i < nr_segments; i++, segno++) {
+        if (segman->segments[segno].valid_blocks == 0) {
+            continue;
+        }
+
+        node = sum_blocks[i].footer.entry_type & SUM_TYPE_NODE;
+        ctrl.fs_info_init(ctrl.fs_manager, &seg_i, first_segment + i);
+        show_segment_info_header(first_segment + i);
+        ctrl.fs_info_show(&seg_i, ctrl.show_only_stats, ctrl.sector_shift);
+        REP_FORMATTER
+
+        for (uint32_t blk = 0; blk < blocks_per_seg; blk++) {
+            /* without bitmaps, all blocks of a segment with valid blocks
+             * are mapped */
+            if (segman->valid_maps &&
+                !f2fs_test_bit(blk, &segman->valid_maps[(size_t)segno *
+                                                        SIT_VBLOCK_MAP_SIZE])) {
+                continue;
+            }
+
+            nid = sum_blocks[i].entries[blk].nid;
+            nat_entry = f2fs_get_nat_entry(nat, nid);
+            ino = nat_entry ? nat_entry->ino : 0;
+            pbas = ((uint64_t)(first_segment + i) << ctrl.segment_shift) +
+                   ((uint64_t)blk << F2FS_BLKSIZE_BITS >> ctrl.sector_shift);
+
+            (*owners)[nr_owners++] = (uint64_t)ino << 1 | node;
+
+            if (run.nr_blks > 0 && run.ino == ino && run.nid == nid &&
+                run.pbas + ((uint64_t)run.nr_blks << F2FS_BLKSIZE_BITS >>
+                            ctrl.sector_shift) ==
+                    pbas) {
+                run.nr_blks++;
+                continue;
+            }
+
+            if (run.nr_blks > 0) {
+                show_rmap_run(&run);
+            }
+
+            run.pbas = pbas;
+            run.nr_blks = 1;
+            run.ino = ino;
+            run.nid = nid;
+            run.node = node;
+        }
+
+        if (run.nr_blks > 0) {
+            show_rmap_run(&run);
+            run.nr_blks = 0;
+        }
+    }
+
+    if (nr_owners > 0) {
+        show_rmap_owners(*owners, nr_owners);
+    }
+
+    free(sum_blocks);
+}
+
+/*
+ * Reverse map the zones in the zone range to the owners of their valid
+ * blocks from the SSA, without walking the directory.
+ *
+ * */
+static void reverse_map_zones() {
+    struct f2fs_nat_index *nat = NULL;
+    uint64_t *owners = NULL;
+    struct segment_manager *segman = ctrl.fs_manager;
+
+    if (segman == NULL) {
+        ERR_MSG("Reverse mapping requires the segment information\n");
+    }
+
+    if (segman->valid_maps == NULL) {
+        WARN("No valid block bitmaps, mapping all blocks of segments with "
+             "valid blocks\n");
+    }
+
+    update_zone_map();
+    nat = f2fs_load_nat_index(ctrl.bdev.dev_path);
+
+    REP_EQUAL_FORMATTER
+    REP(ctrl.show_only_stats, "\t\t\tREVERSE SEGMENT MAPPINGS\n");
+    REP_EQUAL_FORMATTER
+
+    for (uint32_t i = ctrl.start_zone > 0 ? ctrl.start_zone - 1 : 0;
+         i < ctrl.end_zone && i < ctrl.zonemap->nr_zones; i++) {
+        reverse_map_zone(i, nat, &owners);
+    }
+
+    free(owners);
+    free(nat);
+}
+
 int main(int argc, char *argv[]) {
     struct stat *stats;
     char *filename;
@@ -642,8 +1325,9 @@ int main(int argc, char *argv[]) {
     ctrl.exclude_flags = FIEMAP_EXTENT_DATA_INLINE;
     ctrl.show_holes = 1; /* holes only apply to Btrfs */
     ctrl.argv = argv[0];
+    rep_init();
 
-    while ((c = getopt(argc, argv, "d:hil:ws:e:pz:conj:")) != -1) {
+    while ((c = getopt(argc, argv, "d:hil:ws:e:pz:conj:b:x:rt:u")) != -1) {
         switch (c) {
         case 'h':
             show_help();
@@ -662,6 +1346,12 @@ int main(int argc, char *argv[]) {
             ctrl.json_file = optarg;
             ctrl.json_dump = 1;
             break;
+        case 'b':
+            ctrl.snap_file = optarg;
+            break;
+        case 'x':
+            ctrl.csv_file = optarg;
+            break;
         case 'w':
             ctrl.show_flags = 1;
             break;
@@ -691,6 +1381,15 @@ int main(int argc, char *argv[]) {
         case 'n':
             ctrl.show_holes = 0;
             break;
+        case 'r':
+            segmap_man.reverse_map = 1;
+            break;
+        case 't':
+            segmap_man.nr_threads = atoi(optarg);
+            break;
+        case 'u':
+            ctrl.no_sync = 1;
+            break;
         default:
             show_help();
             abort();
@@ -701,17 +1400,12 @@ int main(int argc, char *argv[]) {
         ERR_MSG("Missing directory -d flag.\n");
     }
 
-    if (set_zone && (set_zone_start || set_zone_end)) {
-        ERR_MSG("Flag -z cannot be used with -s or -e\n");
+    if (segmap_man.nr_threads == 0) {
+        segmap_man.nr_threads = 1;
     }
 
-    if (ctrl.show_class_stats && !ctrl.procfs) {
-        if (ctrl.show_only_stats) {
-            ERR_MSG("Cannot show stats without -p enabled\n");
-        }
-
-        WARN("-c requires -p flag to be enabled. Disabling it.\n");
-        ctrl.show_class_stats = 0;
+    if (set_zone && (set_zone_start || set_zone_end)) {
+        ERR_MSG("Flag -z cannot be used with -s or -e\n");
     }
 
     check_dir_init_ctrl();
@@ -724,18 +1418,44 @@ int main(int argc, char *argv[]) {
         ctrl.end_zone = ctrl.znsdev.nr_zones;
     }
 
+    if (segmap_man.reverse_map) {
+        if (ctrl.fs_magic != F2FS_MAGIC) {
+            ERR_MSG("Reverse mapping with -r is only supported for F2FS\n");
+        }
+        if (ctrl.json_dump) {
+            WARN("-j is not supported with -r, ignoring it.\n");
+        }
+        if (ctrl.snap_file) {
+            WARN("-b is not supported with -r, ignoring it.\n");
+        }
+        if (ctrl.csv_file) {
+            WARN("-x is not supported with -r, ignoring it.\n");
+        }
+
+        reverse_map_zones();
+        goto cleanup;
+    }
+
+    /* drop extents outside of the zone range already during collection */
+    ctrl.zone_range_only = set_zone || set_zone_start || set_zone_end;
+
     if (segmap_man.isdir) {
         collect_extents(segmap_man.dir);
         if (ctrl.zonemap->extent_ctr == 0) {
             WARN("No separate extent mappings found for any file.\nFound "
-                 "Inlined inode Extents: %lu\n",
-                 ctrl.inlined_extent_ctr);
+                 "Inlined inode Extents: %lu\nFound Delayed allocation "
+                 "Extents: %lu\nFound Extents outside of the zone range: "
+                 "%lu\n",
+                 ctrl.inlined_extent_ctr, ctrl.delalloc_extent_ctr,
+                 ctrl.range_extent_ctr);
             goto cleanup;
         }
     } else {
         filename = segmap_man.dir;
         fd = open(filename, O_RDONLY);
-        fsync(fd);
+        if (!ctrl.no_sync) {
+            fsync(fd);
+        }
 
         stats = calloc(1, sizeof(struct stat));
 
@@ -743,10 +1463,13 @@ int main(int argc, char *argv[]) {
             ERR_MSG("Failed stat on file %s\n", filename);
         }
 
-        ret = get_extents(filename, fd, stats);
+        ret = get_extents(filename, fd);
 
         if (ret == EXIT_FAILURE) {
             ERR_MSG("retrieving extents for %s\n", filename);
+        } else if (ctrl.zonemap->extent_ctr == 0 &&
+                   ctrl.range_extent_ctr > 0) {
+            ERR_MSG("No extents found in the zone range\n");
         } else if (ctrl.zonemap->extent_ctr == 0) {
             ERR_MSG("No extents found on device\n");
         }
@@ -756,11 +1479,18 @@ int main(int argc, char *argv[]) {
         free(stats);
     }
 
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        if (ctrl.json_dump)
-            json_dump_data(ctrl.zonemap);
-        else
-            show_segment_report();
+    if (ctrl.snap_file || ctrl.json_dump || ctrl.csv_file) {
+        update_zone_map();
+        sort_zone_map();
+
+        if (ctrl.snap_file)
+            snap_write(ctrl.snap_file);
+        if (ctrl.csv_file)
+            csv_dump_data(ctrl.csv_file);
+        if (ctrl.json_dump && ctrl.fs_magic == F2FS_MAGIC)
+            json_dump_data();
+    } else if (ctrl.fs_magic == F2FS_MAGIC) {
+        show_segment_report();
 
         // TODO: clenaup memory
         /*     free(file_counter_map->file); */
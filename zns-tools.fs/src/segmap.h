@@ -1,10 +1,79 @@
 #ifndef _SEGMAP_H_
 #define _SEGMAP_H_
 
+#include "csv.h"
 #include "json.h"
+#include "snapshot.h"
 #include "zns-tools.h"
 
 #include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define WALK_QUEUE_MIN_ENTRIES 64 /* initial entries of the directory queue */
+#define WALK_QUEUE_MAX_FDS 256    /* open directories kept in the queue */
+#define WALK_DENTS_BYTES 65536    /* getdents64() buffer of a walker thread */
+
+/*
+ * Directory entry as returned by getdents64()
+ *
+ * */
+struct linux_dirent64 {
+    uint64_t d_ino;          /* inode number */
+    int64_t d_off;           /* offset to the next entry */
+    unsigned short d_reclen; /* size of this entry */
+    unsigned char d_type;    /* file type */
+    char d_name[];           /* null terminated file name */
+};
+
+/*
+ * Directory in the queue of the walker threads
+ *
+ * */
+struct walk_dir {
+    int fd;     /* open file descriptor of the directory, -1 if not open */
+    char *path; /* full directory path */
+};
+
+/*
+ * A file retrieved by a walker thread, with its extents in the buffer of the
+ * thread
+ *
+ * */
+struct walk_file {
+    char *filename;      /* full file path */
+    uint32_t ext_off;    /* index of the first extent in the thread buffer */
+    uint32_t nr_extents; /* number of extents of the file in the buffer */
+    uint32_t ext_ctr;    /* number of extents of the file, including the
+                            extents outside of the zone range */
+};
+
+/*
+ * Per walker thread state
+ *
+ * */
+struct walk_thread {
+    pthread_t thread;         /* thread id */
+    struct fiemap_buffer buf; /* extents retrieved by the thread */
+    struct walk_file *files;  /* files retrieved by the thread */
+    uint32_t nr_files;        /* number of files in *files */
+    uint32_t files_cap;       /* number of allocated entries in *files */
+};
+
+/*
+ * Queue of directories shared by the walker threads
+ *
+ * */
+struct walk_queue {
+    pthread_mutex_t lock;  /* protects all fields */
+    pthread_cond_t cond;   /* signals new directories or the end of the walk */
+    struct walk_dir *dirs; /* directories that remain to be walked */
+    uint32_t nr_dirs;      /* number of directories in *dirs */
+    uint32_t cap;          /* number of allocated entries in *dirs */
+    uint32_t nr_fds;       /* number of directories in *dirs that are open */
+    uint32_t busy;         /* number of threads walking a directory */
+};
 
 /*
  * Per file segment statistics
@@ -21,6 +90,19 @@ struct file_stats {
     char *filename;       /* full file path that stats are being tracked for */
 };
 
+/*
+ * Run of consecutive valid blocks with the same owner, for the reverse
+ * mapping from the SSA
+ *
+ * */
+struct rmap_run {
+    uint64_t pbas;    /* first sector of the run on the ZNS device */
+    uint32_t nr_blks; /* number of F2FS blocks in the run */
+    uint32_t ino;     /* owning inode, 0 if the nid is not in the NAT */
+    uint32_t nid;     /* owning nid from the summary entries */
+    uint8_t node;     /* run of node blocks instead of data blocks */
+};
+
 struct segmap_manager {
     char *dir;             /* Storing the cmd_line arg */
     uint8_t isdir;         /* identify if it is a directory or a file */
@@ -30,6 +112,9 @@ struct segmap_manager {
     uint32_t hot_ctr;      /* segment type counter: hot */
     struct file_stats *fs; /* file segment stats */
     uint32_t ctr;          /* number of initialized fs entries */
+    uint32_t nr_threads;   /* number of threads to collect extents with */
+    struct walk_queue wq;  /* directories shared by the walker threads */
+    uint8_t reverse_map;   /* map zones to their owners from the SSA */
 };
 
 extern struct segmap_manager segmap_man;
@@ -46,24 +131,25 @@ extern struct extent_map extent_map;
         "___\n");
 
 #define REP_UNDERSCORE                                                         \
-    REP(ctrl.show_only_stats,                                                  \
-        "\n__________________________________________________________________" \
-        "________________________________________________________________"     \
-        "__________\n");
+    REP_PUTS(ctrl.show_only_stats,                                             \
+             "\n_____________________________________________________________" \
+             "_____________________________________________________________"  \
+             "__________________\n");
 
 #define REP_FORMATTER                                                          \
-    REP(ctrl.show_only_stats,                                                  \
-        "--------------------------------------------------------------------" \
-        "----------------------------------------------------------------"     \
-        "--------\n");
+    REP_PUTS(ctrl.show_only_stats,                                             \
+             "---------------------------------------------------------------" \
+             "---------------------------------------------------------------" \
+             "--------------\n");
 
 #define EQUAL_FORMATTER                                                        \
     MSG("\n==================================================================" \
         "==\n");
 
 #define REP_EQUAL_FORMATTER                                                    \
-    REP(ctrl.show_only_stats, "==============================================" \
-                              "======================\n");
+    REP_PUTS(ctrl.show_only_stats,                                             \
+             "==============================================================" \
+             "======\n");
 
 #define FORMATTER_SHORT                                                        \
     MSG("--------------------------------------------------------------------" \
@@ -0,0 +1,254 @@
+#include "snap2json.h"
+
+static struct snapshot snap;
+static struct extent *snap_extents;        /* all extents of the snapshot */
+static struct segment_info *snap_segments; /* info of the segment table */
+
+static struct segment_info snap_unknown_segment = {.type = NO_CHECK_TYPE};
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-f [file]\tSnapshot to convert, as written by zns.segmap -b or "
+        "zns.fiemap -b [Required]\n");
+    MSG("-j [file]\tJson file to write [Required]\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+/*
+ * Get the segment information of a segment from the segment table of the
+ * snapshot, used as ctrl.fs_info_init such that the json dump resolves the
+ * segments of extents as it does for a mapped device.
+ *
+ * @fs_manager: struct snapshot * of the snapshot
+ * @fs_info: struct segment_info * to set
+ * @segment: segment id, relative to the ZNS device
+ *
+ * */
+static void snap_fs_info_init(void *fs_manager, void *fs_info,
+                              uint32_t segment) {
+    struct snapshot *s = (struct snapshot *)fs_manager;
+    struct segment_info *seg_i = (struct segment_info *)fs_info;
+    uint64_t row = snap_find_segment(s, segment);
+
+    *seg_i = snap_unknown_segment;
+    seg_i->id = segment;
+    seg_i->frag = SEGMENT_FRAG_UNKNOWN;
+    seg_i->log_blkoff = CURSEG_NOT_OPEN;
+
+    if (row != SNAP_SEGMENT_NOT_FOUND) {
+        seg_i->type = snap_u32(s, SNAP_SEG_TYPE, row);
+        seg_i->valid_blocks = snap_u32(s, SNAP_SEG_VALID, row);
+    }
+}
+
+/* copy a header field of the snapshot into a zeroed string */
+static void snap_get_str(char *str, size_t size, const char *field,
+                         size_t field_size) {
+    size_t len = strnlen(field, field_size);
+
+    memcpy(str, field, len < size ? len : size - 1);
+}
+
+static void snap_load_dev(struct bdev *bdev, struct snap_dev *dev) {
+    snap_get_str(bdev->dev_name, MAX_DEV_NAME, dev->dev_name,
+                 SNAP_DEV_NAME_LEN);
+    snap_get_str(bdev->dev_path, MAX_PATH_LEN, dev->dev_path,
+                 SNAP_DEV_PATH_LEN);
+    snap_get_str(bdev->link_name, MAX_PATH_LEN, dev->link_name,
+                 SNAP_DEV_PATH_LEN);
+    bdev->is_zoned = le32toh(dev->is_zoned);
+    bdev->zone_mask = le32toh(dev->zone_mask);
+    bdev->nr_zones = le64toh(dev->nr_zones);
+    bdev->zone_size = le64toh(dev->zone_size);
+}
+
+/*
+ * Load the control and the zone map from the snapshot, as they are after
+ * collecting the extents of a device. The paths of the files point into the
+ * mapped snapshot.
+ *
+ * */
+static void snap_load_zonemap() {
+    struct snap_header *hdr = snap.hdr;
+    static char program[SNAP_PROGRAM_LEN + 1];
+    struct extent *extent;
+    struct zone *zone;
+    uint64_t nr_zones = snap_rows(&snap, SNAP_ZONES);
+    uint64_t nr_extents = snap_rows(&snap, SNAP_EXTENTS);
+    uint64_t nr_files = snap_rows(&snap, SNAP_FILES);
+    uint64_t nr_segments = snap_rows(&snap, SNAP_SEGMENTS);
+    uint64_t row, segment;
+    uint32_t zone_nr;
+
+    snap_get_str(program, sizeof(program), hdr->program, SNAP_PROGRAM_LEN);
+    ctrl.argv = program;
+    ctrl.json_time = le64toh(hdr->time);
+    ctrl.fs_magic = le64toh(hdr->fs_magic);
+    ctrl.multi_dev = le32toh(hdr->multi_dev);
+    snap_load_dev(&ctrl.bdev, &hdr->bdev);
+    snap_load_dev(&ctrl.znsdev, &hdr->znsdev);
+    ctrl.sector_size = le32toh(hdr->sector_size);
+    ctrl.sector_shift = le32toh(hdr->sector_shift);
+    ctrl.segment_shift = le32toh(hdr->segment_shift);
+    ctrl.f2fs_segment_sectors = le64toh(hdr->f2fs_segment_sectors);
+    ctrl.f2fs_segment_mask = le64toh(hdr->f2fs_segment_mask);
+    ctrl.fs_manager = &snap;
+    ctrl.fs_info_init = (fs_info_init)&snap_fs_info_init;
+    ctrl.start_zone = 1;
+    ctrl.end_zone = nr_zones;
+
+    if (nr_zones > UINT32_MAX || nr_files > UINT32_MAX ||
+        ctrl.segment_shift >= 64) {
+        ERR_MSG("Snapshot is corrupted\n");
+    }
+
+    ctrl.zonemap =
+        calloc(1, sizeof(struct zone_map) + sizeof(struct zone) * nr_zones);
+    snap_extents = calloc(nr_extents, sizeof(struct extent));
+    snap_segments = calloc(nr_segments, sizeof(struct segment_info));
+    if (!ctrl.zonemap || (nr_extents && !snap_extents) ||
+        (nr_segments && !snap_segments)) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    ctrl.zonemap->nr_zones = nr_zones;
+    ctrl.zonemap->extent_ctr = nr_extents;
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+
+        zone->zone_number = i;
+        zone->start = snap_u64(&snap, SNAP_ZONE_START, i);
+        zone->capacity = snap_u64(&snap, SNAP_ZONE_CAP, i);
+        zone->end = zone->start + zone->capacity;
+        zone->wp = snap_u64(&snap, SNAP_ZONE_WP, i);
+        zone->size = snap_u64(&snap, SNAP_ZONE_SIZE, i);
+        zone->state = snap_u32(&snap, SNAP_ZONE_STATE, i);
+        zone->mask = ctrl.znsdev.zone_mask;
+        zone->sorted = 1;
+    }
+
+    for (row = 0; row < nr_segments; row++) {
+        snap_fs_info_init(&snap, &snap_segments[row],
+                          snap_u64(&snap, SNAP_SEG_ID, row));
+    }
+
+    /* extents are sorted by zone, count the extents of each zone first */
+    for (row = 0; row < nr_extents; row++) {
+        zone_nr = snap_u32(&snap, SNAP_EXT_ZONE, row);
+        if (zone_nr >= nr_zones ||
+            snap_u32(&snap, SNAP_EXT_FILE, row) >= nr_files) {
+            ERR_MSG("Snapshot is corrupted\n");
+        }
+
+        ctrl.zonemap->zones[zone_nr].extent_cap++;
+    }
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        zone = &ctrl.zonemap->zones[i];
+        if (zone->extent_cap == 0) {
+            continue;
+        }
+
+        zone->extents = malloc(sizeof(struct extent *) * zone->extent_cap);
+        if (!zone->extents) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        ctrl.zonemap->zone_ctr++;
+    }
+
+    for (row = 0; row < nr_extents; row++) {
+        extent = &snap_extents[row];
+
+        extent->phy_blk = snap_u64(&snap, SNAP_EXT_PBAS, row);
+        extent->len = snap_u64(&snap, SNAP_EXT_LEN, row);
+        extent->logical_blk = snap_u64(&snap, SNAP_EXT_LBAS, row);
+        extent->fileID = snap_u32(&snap, SNAP_EXT_FILE, row);
+        extent->ext_nr = snap_u32(&snap, SNAP_EXT_NR, row);
+        extent->flags = snap_u32(&snap, SNAP_EXT_FLAGS, row);
+        extent->zone = snap_u32(&snap, SNAP_EXT_ZONE, row);
+        ctrl.zonemap->cum_extent_size += extent->len;
+
+        segment = (extent->phy_blk & ctrl.f2fs_segment_mask) >>
+                  ctrl.segment_shift;
+        segment = snap_find_segment(&snap, segment);
+        extent->fs_info = segment == SNAP_SEGMENT_NOT_FOUND
+                              ? &snap_unknown_segment
+                              : &snap_segments[segment];
+
+        zone = &ctrl.zonemap->zones[extent->zone];
+        zone->extents[zone->extent_ctr++] = extent;
+    }
+
+    if (nr_files == 0) {
+        return;
+    }
+
+    if (reserve_file_counter_map(nr_files) == EXIT_FAILURE) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        ctrl.file_counter_map->files[i].file = (char *)snap_path(&snap, i);
+        ctrl.file_counter_map->files[i].ext_ctr =
+            snap_u32(&snap, SNAP_FILE_EXTS, i);
+    }
+    ctrl.file_counter_map->file_ctr = nr_files;
+    ctrl.nr_files = nr_files;
+}
+
+int main(int argc, char *argv[]) {
+    char *snap_file = NULL;
+    int c;
+
+    memset(&ctrl, 0, sizeof(struct control));
+
+    while ((c = getopt(argc, argv, "f:hj:")) != -1) {
+        switch (c) {
+        case 'h':
+            show_help();
+            break;
+        case 'f':
+            snap_file = optarg;
+            break;
+        case 'j':
+            ctrl.json_file = optarg;
+            ctrl.json_dump = 1;
+            break;
+        default:
+            show_help();
+            abort();
+        }
+    }
+
+    if (!snap_file || !ctrl.json_dump) {
+        MSG("Missing snapshot or json file option\n");
+        show_help();
+    }
+
+    snap_open(&snap, snap_file);
+    snap_load_zonemap();
+
+    if (ctrl.fs_magic != F2FS_MAGIC) {
+        WARN("Snapshot is not of F2FS, only writing the device info.\n");
+    }
+
+    json_dump_data();
+
+    cleanup_zonemap();
+    free(ctrl.zonemap);
+    free(snap_extents);
+    free(snap_segments);
+    free(ctrl.file_counter_map);
+    snap_close(&snap);
+
+    return EXIT_SUCCESS;
+}
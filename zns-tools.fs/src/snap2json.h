@@ -0,0 +1,8 @@
+#ifndef _SNAP2JSON_H_
+#define _SNAP2JSON_H_
+
+#include "json.h"
+#include "snapshot.h"
+#include "zns-tools.h"
+
+#endif
@@ -0,0 +1,567 @@
+#include "snapdiff.h"
+
+static struct snapdiff_manager diff_man;
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-o [file]\tOlder snapshot, as written by zns.segmap -b or "
+        "zns.fiemap -b [Required]\n");
+    MSG("-n [file]\tNewer snapshot of the same device [Required]\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+static uint64_t snapdiff_hash_u64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+
+    return value;
+}
+
+static uint64_t snapdiff_hash_str(const char *str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (; *str; str++) {
+        hash = (hash ^ (unsigned char)*str) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Allocate a hash table with at least twice the number of slots of the rows
+ * that are inserted, such that probe sequences stay short.
+ *
+ * @hash: struct snapdiff_hash * to initialize
+ * @nr_rows: number of rows that are inserted
+ *
+ * */
+static void snapdiff_hash_init(struct snapdiff_hash *hash, uint64_t nr_rows) {
+    uint64_t nr_slots = 16;
+
+    while (nr_slots < nr_rows * 2) {
+        nr_slots <<= 1;
+    }
+
+    hash->slots = malloc(sizeof(uint64_t) * nr_slots);
+    if (!hash->slots) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    memset(hash->slots, 0xff, sizeof(uint64_t) * nr_slots);
+    hash->mask = nr_slots - 1;
+}
+
+/*
+ * Map the files of the old snapshot to the files of the new snapshot by their
+ * path, with a hash table of the new paths.
+ *
+ * */
+static void snapdiff_map_files() {
+    struct snapdiff_hash hash;
+    uint64_t nr_old = snap_rows(&diff_man.old, SNAP_FILES);
+    uint64_t nr_new = snap_rows(&diff_man.new, SNAP_FILES);
+    uint64_t slot;
+    const char *path;
+
+    snapdiff_hash_init(&hash, nr_new);
+
+    for (uint64_t i = 0; i < nr_new; i++) {
+        slot = snapdiff_hash_str(snap_path(&diff_man.new, i)) & hash.mask;
+        while (hash.slots[slot] != SNAPDIFF_EMPTY_SLOT) {
+            slot = (slot + 1) & hash.mask;
+        }
+        hash.slots[slot] = i;
+    }
+
+    for (uint64_t i = 0; i < nr_old; i++) {
+        path = snap_path(&diff_man.old, i);
+        slot = snapdiff_hash_str(path) & hash.mask;
+        diff_man.file_map[i] = SNAPDIFF_NO_FILE;
+
+        for (; hash.slots[slot] != SNAPDIFF_EMPTY_SLOT;
+             slot = (slot + 1) & hash.mask) {
+            if (!strcmp(snap_path(&diff_man.new, hash.slots[slot]), path)) {
+                diff_man.file_map[i] = hash.slots[slot];
+                break;
+            }
+        }
+    }
+
+    free(hash.slots);
+}
+
+/*
+ * Sort-merge the extents of both snapshots, which are sorted by PBAS, and
+ * mark the extents that are only in one of the snapshots as changed.
+ * Extents are kept if they have the same address and size, and belong to the
+ * same file.
+ *
+ * */
+static void snapdiff_merge_extents() {
+    struct snapshot *old = &diff_man.old, *new = &diff_man.new;
+    uint64_t nr_old = snap_rows(old, SNAP_EXTENTS);
+    uint64_t nr_new = snap_rows(new, SNAP_EXTENTS);
+    uint64_t i = 0, j = 0, old_pbas, new_pbas;
+
+    while (i < nr_old && j < nr_new) {
+        old_pbas = snap_u64(old, SNAP_EXT_PBAS, i);
+        new_pbas = snap_u64(new, SNAP_EXT_PBAS, j);
+
+        if (old_pbas < new_pbas) {
+            diff_man.old_state[i++] = SNAPDIFF_CHANGED;
+        } else if (new_pbas < old_pbas) {
+            diff_man.new_state[j++] = SNAPDIFF_CHANGED;
+        } else {
+            if (snap_u64(old, SNAP_EXT_LEN, i) ==
+                    snap_u64(new, SNAP_EXT_LEN, j) &&
+                diff_man.file_map[snap_u32(old, SNAP_EXT_FILE, i)] ==
+                    snap_u32(new, SNAP_EXT_FILE, j)) {
+                diff_man.old_state[i] = SNAPDIFF_KEPT;
+                diff_man.new_state[j] = SNAPDIFF_KEPT;
+            } else {
+                diff_man.old_state[i] = SNAPDIFF_CHANGED;
+                diff_man.new_state[j] = SNAPDIFF_CHANGED;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    for (; i < nr_old; i++) {
+        diff_man.old_state[i] = SNAPDIFF_CHANGED;
+    }
+
+    for (; j < nr_new; j++) {
+        diff_man.new_state[j] = SNAPDIFF_CHANGED;
+    }
+}
+
+/* hash of the file data an extent holds, its file and logical offset */
+static uint64_t snapdiff_hash_extent(uint32_t file, uint64_t lbas) {
+    return snapdiff_hash_u64(lbas ^ ((uint64_t)file << 40) ^ file);
+}
+
+/*
+ * Match removed extents of the old snapshot with added extents of the new
+ * snapshot that hold the same file data (same file and logical offset), and
+ * mark these as moved, e.g., by GC or by the file system relocating data.
+ *
+ * */
+static void snapdiff_match_moved() {
+    struct snapshot *old = &diff_man.old, *new = &diff_man.new;
+    struct snapdiff_hash hash;
+    uint64_t nr_old = snap_rows(old, SNAP_EXTENTS);
+    uint64_t nr_new = snap_rows(new, SNAP_EXTENTS);
+    uint64_t slot, row, lbas;
+    uint32_t file;
+
+    snapdiff_hash_init(&hash, nr_old);
+
+    for (uint64_t i = 0; i < nr_old; i++) {
+        file = diff_man.file_map[snap_u32(old, SNAP_EXT_FILE, i)];
+        if (diff_man.old_state[i] != SNAPDIFF_CHANGED ||
+            file == SNAPDIFF_NO_FILE) {
+            continue;
+        }
+
+        slot = snapdiff_hash_extent(file, snap_u64(old, SNAP_EXT_LBAS, i)) &
+               hash.mask;
+        while (hash.slots[slot] != SNAPDIFF_EMPTY_SLOT) {
+            slot = (slot + 1) & hash.mask;
+        }
+        hash.slots[slot] = i;
+    }
+
+    for (uint64_t j = 0; j < nr_new; j++) {
+        if (diff_man.new_state[j] != SNAPDIFF_CHANGED) {
+            continue;
+        }
+
+        file = snap_u32(new, SNAP_EXT_FILE, j);
+        lbas = snap_u64(new, SNAP_EXT_LBAS, j);
+        slot = snapdiff_hash_extent(file, lbas) & hash.mask;
+
+        for (; hash.slots[slot] != SNAPDIFF_EMPTY_SLOT;
+             slot = (slot + 1) & hash.mask) {
+            row = hash.slots[slot];
+            if (diff_man.old_state[row] == SNAPDIFF_CHANGED &&
+                diff_man.file_map[snap_u32(old, SNAP_EXT_FILE, row)] == file &&
+                snap_u64(old, SNAP_EXT_LBAS, row) == lbas) {
+                diff_man.old_state[row] = SNAPDIFF_MOVED;
+                diff_man.new_state[j] = SNAPDIFF_MOVED;
+                break;
+            }
+        }
+    }
+
+    free(hash.slots);
+}
+
+/*
+ * Count the deltas of the extents in the zones and files they belong to.
+ *
+ * */
+static void snapdiff_count_extents() {
+    struct snapshot *old = &diff_man.old, *new = &diff_man.new;
+    struct snapdiff_zone *zone;
+    struct snapdiff_file *file;
+    uint64_t len;
+    uint32_t file_nr;
+
+    for (uint64_t i = 0; i < snap_rows(old, SNAP_EXTENTS); i++) {
+        if (diff_man.old_state[i] == SNAPDIFF_KEPT) {
+            continue;
+        }
+
+        zone = &diff_man.zones[snap_u32(old, SNAP_EXT_ZONE, i)];
+        file_nr = snap_u32(old, SNAP_EXT_FILE, i);
+        file = diff_man.file_map[file_nr] == SNAPDIFF_NO_FILE
+                   ? &diff_man.old_files[file_nr]
+                   : &diff_man.new_files[diff_man.file_map[file_nr]];
+        len = snap_u64(old, SNAP_EXT_LEN, i);
+
+        if (diff_man.old_state[i] == SNAPDIFF_MOVED) {
+            zone->moved_out += len;
+        } else {
+            zone->removed++;
+            zone->removed_sectors += len;
+            file->removed++;
+        }
+    }
+
+    for (uint64_t j = 0; j < snap_rows(new, SNAP_EXTENTS); j++) {
+        if (diff_man.new_state[j] == SNAPDIFF_KEPT) {
+            continue;
+        }
+
+        zone = &diff_man.zones[snap_u32(new, SNAP_EXT_ZONE, j)];
+        file = &diff_man.new_files[snap_u32(new, SNAP_EXT_FILE, j)];
+        len = snap_u64(new, SNAP_EXT_LEN, j);
+
+        if (diff_man.new_state[j] == SNAPDIFF_MOVED) {
+            zone->moved_in += len;
+            file->moved++;
+            file->moved_sectors += len;
+        } else {
+            zone->added++;
+            zone->added_sectors += len;
+            file->added++;
+        }
+    }
+}
+
+/*
+ * Sort-merge the segment tables of both snapshots, which are sorted by id,
+ * and count the segments that are only occupied in one of the snapshots.
+ * Freed segments from which extents were moved count as migrated, which is
+ * how segments that were cleaned by GC show up.
+ *
+ * */
+static void snapdiff_count_segments() {
+    struct snapshot *old = &diff_man.old, *new = &diff_man.new;
+    uint64_t nr_old = snap_rows(old, SNAP_SEGMENTS);
+    uint64_t nr_new = snap_rows(new, SNAP_SEGMENTS);
+    uint64_t zone_size = le64toh(old->hdr->znsdev.zone_size);
+    uint32_t shift = le32toh(old->hdr->segment_shift);
+    uint64_t mask = le64toh(old->hdr->f2fs_segment_mask);
+    uint64_t nr_zones = snap_rows(old, SNAP_ZONES);
+    uint64_t i = 0, j = 0, seg = 0, first, last, pbas, old_id, new_id, zone;
+    uint8_t *moved;
+
+    if (zone_size == 0 || (nr_old == 0 && nr_new == 0)) {
+        return;
+    }
+
+    /* extents and segments are both sorted, mark the old segments that
+     * extents were moved from in a single pass */
+    moved = calloc(nr_old ? nr_old : 1, sizeof(uint8_t));
+    if (!moved) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint64_t e = 0; e < snap_rows(old, SNAP_EXTENTS) && nr_old; e++) {
+        if (diff_man.old_state[e] != SNAPDIFF_MOVED) {
+            continue;
+        }
+
+        pbas = snap_u64(old, SNAP_EXT_PBAS, e);
+        first = (pbas & mask) >> shift;
+        last = ((pbas + snap_u64(old, SNAP_EXT_LEN, e) - 1) & mask) >> shift;
+
+        for (; seg < nr_old && snap_u64(old, SNAP_SEG_ID, seg) <= last; seg++) {
+            if (snap_u64(old, SNAP_SEG_ID, seg) >= first) {
+                moved[seg] = 1;
+            }
+        }
+
+        /* the last segment can hold the next moved extent as well */
+        if (seg > 0 && snap_u64(old, SNAP_SEG_ID, seg - 1) == last) {
+            seg--;
+        }
+    }
+
+    while (i < nr_old || j < nr_new) {
+        old_id = i < nr_old ? snap_u64(old, SNAP_SEG_ID, i) : UINT64_MAX;
+        new_id = j < nr_new ? snap_u64(new, SNAP_SEG_ID, j) : UINT64_MAX;
+
+        if (old_id < new_id) {
+            zone = (old_id << shift) / zone_size;
+            if (zone < nr_zones) {
+                diff_man.zones[zone].segs_freed++;
+                diff_man.zones[zone].segs_migrated += moved[i];
+            }
+            i++;
+        } else if (new_id < old_id) {
+            zone = (new_id << shift) / zone_size;
+            if (zone < nr_zones) {
+                diff_man.zones[zone].segs_new++;
+            }
+            j++;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    free(moved);
+}
+
+static void show_zone_deltas() {
+    struct snapdiff_zone *zone;
+    uint64_t old_wp, new_wp;
+
+    EQUAL_FORMATTER
+    MSG("\t\t\tZONE DELTAS");
+    EQUAL_FORMATTER
+
+    FORMATTER
+    MSG("%-6s | %-12s | %-12s | %-5s | %-9s | %-12s | %-9s | %-12s | %-12s | "
+        "%-12s | %-8s | %-10s | %-13s\n",
+        "Zone", "Old WP", "New WP", "Reset", "Added", "Added Size",
+        "Removed", "Removed Size", "Moved In", "Moved Out", "Segs New",
+        "Segs Freed", "Segs Migrated");
+    FORMATTER
+
+    for (uint64_t i = 0; i < snap_rows(&diff_man.old, SNAP_ZONES); i++) {
+        zone = &diff_man.zones[i];
+        old_wp = snap_u64(&diff_man.old, SNAP_ZONE_WP, i);
+        new_wp = snap_u64(&diff_man.new, SNAP_ZONE_WP, i);
+
+        if (old_wp == new_wp && !zone->added && !zone->removed &&
+            !zone->moved_in && !zone->moved_out && !zone->segs_new &&
+            !zone->segs_freed) {
+            continue;
+        }
+
+        MSG("%-6lu | %#-12lx | %#-12lx | %-5s | %-9lu | %#-12lx | %-9lu | "
+            "%#-12lx | %#-12lx | %#-12lx | %-8u | %-10u | %-13u\n",
+            i, old_wp, new_wp, new_wp < old_wp ? "yes" : "no", zone->added,
+            zone->added_sectors, zone->removed, zone->removed_sectors,
+            zone->moved_in, zone->moved_out, zone->segs_new,
+            zone->segs_freed, zone->segs_migrated);
+    }
+}
+
+static void show_file_delta(const char *path, struct snapdiff_file *file,
+                            const char *status) {
+    if (!file->added && !file->removed && !file->moved &&
+        !strcmp(status, "-")) {
+        return;
+    }
+
+    MSG("%-50s | %-9lu | %-9lu | %-9lu | %#-12lx | %-7s\n", path,
+        file->added, file->removed, file->moved, file->moved_sectors, status);
+}
+
+static void show_file_deltas() {
+    uint64_t nr_new = snap_rows(&diff_man.new, SNAP_FILES);
+    uint8_t *in_old;
+
+    in_old = calloc(nr_new ? nr_new : 1, sizeof(uint8_t));
+    if (!in_old) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint64_t i = 0; i < snap_rows(&diff_man.old, SNAP_FILES); i++) {
+        if (diff_man.file_map[i] != SNAPDIFF_NO_FILE) {
+            in_old[diff_man.file_map[i]] = 1;
+        }
+    }
+
+    EQUAL_FORMATTER
+    MSG("\t\t\tFILE DELTAS");
+    EQUAL_FORMATTER
+
+    FORMATTER
+    MSG("%-50s | %-9s | %-9s | %-9s | %-12s | %-7s\n", "File", "Added",
+        "Removed", "Moved", "Moved Size", "Status");
+    FORMATTER
+
+    for (uint64_t i = 0; i < nr_new; i++) {
+        show_file_delta(snap_path(&diff_man.new, i), &diff_man.new_files[i],
+                        in_old[i] ? "-" : "NEW");
+    }
+
+    for (uint64_t i = 0; i < snap_rows(&diff_man.old, SNAP_FILES); i++) {
+        if (diff_man.file_map[i] == SNAPDIFF_NO_FILE) {
+            show_file_delta(snap_path(&diff_man.old, i),
+                            &diff_man.old_files[i], "DELETED");
+        }
+    }
+
+    free(in_old);
+}
+
+static void show_summary() {
+    uint64_t added = 0, removed = 0, moved = 0, moved_sectors = 0;
+    uint64_t resets = 0, migrated = 0;
+
+    for (uint64_t i = 0; i < snap_rows(&diff_man.old, SNAP_ZONES); i++) {
+        added += diff_man.zones[i].added;
+        removed += diff_man.zones[i].removed;
+        moved_sectors += diff_man.zones[i].moved_in;
+        migrated += diff_man.zones[i].segs_migrated;
+        resets += snap_u64(&diff_man.new, SNAP_ZONE_WP, i) <
+                  snap_u64(&diff_man.old, SNAP_ZONE_WP, i);
+    }
+
+    for (uint64_t j = 0; j < snap_rows(&diff_man.new, SNAP_EXTENTS); j++) {
+        moved += diff_man.new_state[j] == SNAPDIFF_MOVED;
+    }
+
+    EQUAL_FORMATTER
+    MSG("\t\t\tSUMMARY");
+    EQUAL_FORMATTER
+
+    MSG("Old Extents:        %lu\n", snap_rows(&diff_man.old, SNAP_EXTENTS));
+    MSG("New Extents:        %lu\n", snap_rows(&diff_man.new, SNAP_EXTENTS));
+    MSG("Added Extents:      %lu\n", added);
+    MSG("Removed Extents:    %lu\n", removed);
+    MSG("Moved Extents:      %lu (%#lx sectors)\n", moved, moved_sectors);
+    MSG("Reset Zones:        %lu\n", resets);
+    MSG("Migrated Segments:  %lu\n", migrated);
+}
+
+/*
+ * Check that both snapshots are of the same device layout, such that zones,
+ * segments, and addresses can be compared.
+ *
+ * */
+static void snapdiff_check_layout() {
+    struct snap_header *old = diff_man.old.hdr, *new = diff_man.new.hdr;
+
+    if (snap_rows(&diff_man.old, SNAP_ZONES) !=
+            snap_rows(&diff_man.new, SNAP_ZONES) ||
+        old->znsdev.zone_size != new->znsdev.zone_size ||
+        old->sector_shift != new->sector_shift ||
+        old->segment_shift != new->segment_shift ||
+        old->fs_magic != new->fs_magic) {
+        ERR_MSG("Snapshots are not of the same device and file system\n");
+    }
+
+    if (le32toh(old->segment_shift) >= 64) {
+        ERR_MSG("Snapshot is corrupted\n");
+    }
+
+    /* rows that index the zone and file tables are used without checks */
+    for (uint64_t i = 0; i < snap_rows(&diff_man.old, SNAP_EXTENTS); i++) {
+        if (snap_u32(&diff_man.old, SNAP_EXT_ZONE, i) >=
+                snap_rows(&diff_man.old, SNAP_ZONES) ||
+            snap_u32(&diff_man.old, SNAP_EXT_FILE, i) >=
+                snap_rows(&diff_man.old, SNAP_FILES)) {
+            ERR_MSG("Snapshot is corrupted\n");
+        }
+    }
+
+    for (uint64_t j = 0; j < snap_rows(&diff_man.new, SNAP_EXTENTS); j++) {
+        if (snap_u32(&diff_man.new, SNAP_EXT_ZONE, j) >=
+                snap_rows(&diff_man.new, SNAP_ZONES) ||
+            snap_u32(&diff_man.new, SNAP_EXT_FILE, j) >=
+                snap_rows(&diff_man.new, SNAP_FILES)) {
+            ERR_MSG("Snapshot is corrupted\n");
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char *old_file = NULL, *new_file = NULL;
+    uint64_t nr_zones;
+    int c;
+
+    memset(&ctrl, 0, sizeof(struct control));
+
+    while ((c = getopt(argc, argv, "hn:o:")) != -1) {
+        switch (c) {
+        case 'h':
+            show_help();
+            break;
+        case 'o':
+            old_file = optarg;
+            break;
+        case 'n':
+            new_file = optarg;
+            break;
+        default:
+            show_help();
+            abort();
+        }
+    }
+
+    if (!old_file || !new_file) {
+        MSG("Missing snapshot option\n");
+        show_help();
+    }
+
+    snap_open(&diff_man.old, old_file);
+    snap_open(&diff_man.new, new_file);
+    snapdiff_check_layout();
+
+    nr_zones = snap_rows(&diff_man.old, SNAP_ZONES);
+    diff_man.old_state =
+        calloc(snap_rows(&diff_man.old, SNAP_EXTENTS) + 1, sizeof(uint8_t));
+    diff_man.new_state =
+        calloc(snap_rows(&diff_man.new, SNAP_EXTENTS) + 1, sizeof(uint8_t));
+    diff_man.file_map =
+        calloc(snap_rows(&diff_man.old, SNAP_FILES) + 1, sizeof(uint32_t));
+    diff_man.old_files = calloc(snap_rows(&diff_man.old, SNAP_FILES) + 1,
+                                sizeof(struct snapdiff_file));
+    diff_man.new_files = calloc(snap_rows(&diff_man.new, SNAP_FILES) + 1,
+                                sizeof(struct snapdiff_file));
+    diff_man.zones = calloc(nr_zones + 1, sizeof(struct snapdiff_zone));
+    if (!diff_man.old_state || !diff_man.new_state || !diff_man.file_map ||
+        !diff_man.old_files || !diff_man.new_files || !diff_man.zones) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    snapdiff_map_files();
+    snapdiff_merge_extents();
+    snapdiff_match_moved();
+    snapdiff_count_extents();
+    snapdiff_count_segments();
+
+    show_zone_deltas();
+    show_file_deltas();
+    show_summary();
+
+    free(diff_man.old_state);
+    free(diff_man.new_state);
+    free(diff_man.file_map);
+    free(diff_man.old_files);
+    free(diff_man.new_files);
+    free(diff_man.zones);
+    snap_close(&diff_man.old);
+    snap_close(&diff_man.new);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#ifndef _SNAPDIFF_H_
+#define _SNAPDIFF_H_
+
+#include "snapshot.h"
+#include "zns-tools.h"
+
+#define SNAPDIFF_NO_FILE UINT32_MAX    /* old file not in the new snapshot */
+#define SNAPDIFF_EMPTY_SLOT UINT64_MAX /* unused slot of a snapdiff_hash */
+
+/* state of an extent, compared to the other snapshot */
+enum snapdiff_state {
+    SNAPDIFF_KEPT = 0, /* same extent of the same file in both snapshots */
+    SNAPDIFF_CHANGED,  /* only in this snapshot (added or removed) */
+    SNAPDIFF_MOVED,    /* file data that is at a different address in the
+                          other snapshot */
+};
+
+/*
+ * Open addressing hash table of row numbers, with linear probing
+ *
+ * */
+struct snapdiff_hash {
+    uint64_t *slots; /* rows, SNAPDIFF_EMPTY_SLOT if the slot is unused */
+    uint64_t mask;   /* number of slots - 1, slots are a power of 2 */
+};
+
+struct snapdiff_zone {
+    uint64_t added;           /* extents only in the new snapshot */
+    uint64_t added_sectors;   /* sectors of the added extents */
+    uint64_t removed;         /* extents only in the old snapshot */
+    uint64_t removed_sectors; /* sectors of the removed extents */
+    uint64_t moved_in;        /* sectors of file data moved into the zone */
+    uint64_t moved_out;       /* sectors of file data moved out of the zone */
+    uint32_t segs_new;        /* segments only occupied in the new snapshot */
+    uint32_t segs_freed;      /* segments only occupied in the old snapshot */
+    uint32_t segs_migrated;   /* freed segments with data that was moved */
+};
+
+struct snapdiff_file {
+    uint64_t added;         /* extents only in the new snapshot */
+    uint64_t removed;       /* extents only in the old snapshot */
+    uint64_t moved;         /* extents at a different address */
+    uint64_t moved_sectors; /* sectors of the moved extents */
+};
+
+struct snapdiff_manager {
+    struct snapshot old;              /* older snapshot */
+    struct snapshot new;              /* newer snapshot */
+    uint8_t *old_state;               /* enum snapdiff_state of old extents */
+    uint8_t *new_state;               /* enum snapdiff_state of new extents */
+    uint32_t *file_map;               /* new fileID of each old file */
+    struct snapdiff_zone *zones;      /* deltas of each zone */
+    struct snapdiff_file *new_files;  /* deltas of each new file */
+    struct snapdiff_file *old_files;  /* deltas of old files that are not in
+                                         the new snapshot */
+};
+
+#define EQUAL_FORMATTER                                                        \
+    MSG("\n==================================================================" \
+        "==\n");
+
+#endif